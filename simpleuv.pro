@@ -14,14 +14,69 @@ HEADERS += simpleuv/uvunwrapper.h
 SOURCES += simpleuv/parametrize.cpp
 HEADERS += simpleuv/parametrize.h
 
+SOURCES += simpleuv/arapsolver.cpp
+HEADERS += simpleuv/arapsolver.h
+
+SOURCES += simpleuv/vertexordering.cpp
+HEADERS += simpleuv/vertexordering.h
+
+SOURCES += simpleuv/cotangentlaplacian.cpp
+HEADERS += simpleuv/cotangentlaplacian.h
+
+SOURCES += simpleuv/boundaryfirstflattening.cpp
+HEADERS += simpleuv/boundaryfirstflattening.h
+
+SOURCES += simpleuv/graphpartitioner.cpp
+HEADERS += simpleuv/graphpartitioner.h
+
+SOURCES += simpleuv/islandmerger.cpp
+HEADERS += simpleuv/islandmerger.h
+
+SOURCES += simpleuv/congruentislands.cpp
+HEADERS += simpleuv/congruentislands.h
+
 SOURCES += simpleuv/chartpacker.cpp
 HEADERS += simpleuv/chartpacker.h
 
+SOURCES += simpleuv/skylinepacker.cpp
+HEADERS += simpleuv/skylinepacker.h
+
+SOURCES += simpleuv/rasterchartpacker.cpp
+HEADERS += simpleuv/rasterchartpacker.h
+
+SOURCES += simpleuv/streamingchartpacker.cpp
+HEADERS += simpleuv/streamingchartpacker.h
+
 SOURCES += simpleuv/triangulate.cpp
 HEADERS += simpleuv/triangulate.h
 
+SOURCES += simpleuv/meshdatatype.cpp
 HEADERS += simpleuv/meshdatatype.h
 
+SOURCES += simpleuv/facenormals.cpp
+HEADERS += simpleuv/facenormals.h
+
+SOURCES += simpleuv/oppositefaces.cpp
+HEADERS += simpleuv/oppositefaces.h
+
+SOURCES += simpleuv/uvtransform.cpp
+HEADERS += simpleuv/uvtransform.h
+
+SOURCES += simpleuv/gutterdilation.cpp
+HEADERS += simpleuv/gutterdilation.h
+
+SOURCES += simpleuv/uvrasterizer.cpp
+HEADERS += simpleuv/uvrasterizer.h
+
+SOURCES += simpleuv/uvmetrics.cpp
+HEADERS += simpleuv/uvmetrics.h
+
+SOURCES += simpleuv/workstealingpool.cpp
+HEADERS += simpleuv/workstealingpool.h
+
+HEADERS += simpleuv/simd.h
+HEADERS += simpleuv/parallelfor.h
+
 SOURCES += thirdparty/squeezer/maxrects.c
 HEADERS += thirdparty/squeezer/maxrects.h
 
@@ -0,0 +1,421 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <igl/massmatrix.h>
+#include <igl/harmonic.h>
+#include <igl/covariance_scatter_matrix.h>
+#include <igl/arap_rhs.h>
+#include <igl/project_isometrically_to_plane.h>
+#include <igl/repdiag.h>
+#include <igl/fit_rotations.h>
+#include <igl/columnize.h>
+#include <igl/vector_area_matrix.h>
+#include <igl/min_quad_with_fixed.h>
+#include <Eigen/OrderingMethods>
+#include <simpleuv/arapsolver.h>
+
+namespace simpleuv
+{
+
+ArapSolver::ArapSolver(const ArapOptions &options) :
+    m_options(options)
+{
+    m_laplacian.setThreadNum(m_options.threadNum);
+}
+
+size_t ArapSolver::estimateFactorBytes(const Eigen::SparseMatrix<double> &matrix)
+{
+    // Same ordering and symbolic analysis as Eigen::SimplicialLLT, without allocating the factor
+    int n = matrix.rows();
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inversePermutation;
+    Eigen::AMDOrdering<int> ordering;
+    ordering(matrix, inversePermutation);
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> permutation = inversePermutation.inverse();
+    Eigen::SparseMatrix<double> upper(n, n);
+    upper.selfadjointView<Eigen::Upper>() = matrix.selfadjointView<Eigen::Lower>().twistedBy(permutation);
+    std::vector<int> parents(n);
+    std::vector<int> tags(n);
+    size_t nonZeroNum = n;
+    for (int k = 0; k < n; ++k) {
+        parents[k] = -1;
+        tags[k] = k;
+        for (Eigen::SparseMatrix<double>::InnerIterator it(upper, k); it; ++it) {
+            int i = it.index();
+            if (i >= k)
+                continue;
+            for (; tags[i] != k; i = parents[i]) {
+                if (-1 == parents[i])
+                    parents[i] = k;
+                ++nonZeroNum;
+                tags[i] = k;
+            }
+        }
+    }
+    return nonZeroNum * (sizeof(double) + sizeof(int)) + (size_t)n * sizeof(int) * 4;
+}
+
+bool ArapSolver::useIterative(const Eigen::MatrixXi &F, const Eigen::SparseMatrix<double> &matrix)
+{
+    switch (m_options.linearSolver) {
+    case LinearSolver::Direct:
+        return false;
+    case LinearSolver::Iterative:
+        return true;
+    default:
+        break;
+    }
+    if (matrix.rows() == m_decidedSize && F.rows() == m_decidedFaces.rows() && F == m_decidedFaces)
+        return m_decidedIterative;
+    m_decidedFaces = F;
+    m_decidedSize = matrix.rows();
+    m_decidedIterative = estimateFactorBytes(matrix) > m_options.memoryBudget;
+    return m_decidedIterative;
+}
+
+bool ArapSolver::solveIterativeWithFixed(const Eigen::SparseMatrix<double> &A, const Eigen::VectorXi &known,
+    const Eigen::MatrixXd &knownValues, Eigen::MatrixXd &X) const
+{
+    // The fixed rows move to the right hand side
+    int n = A.rows();
+    std::vector<int> freeIndices(n, 0);
+    for (int i = 0; i < known.size(); ++i)
+        freeIndices[known(i)] = -1;
+    int freeNum = 0;
+    for (int i = 0; i < n; ++i) {
+        if (-1 != freeIndices[i])
+            freeIndices[i] = freeNum++;
+    }
+    X.resize(n, knownValues.cols());
+    for (int i = 0; i < known.size(); ++i)
+        X.row(known(i)) = knownValues.row(i);
+    if (0 == freeNum)
+        return true;
+    Eigen::MatrixXd rhs = Eigen::MatrixXd::Zero(freeNum, X.cols());
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(A.nonZeros());
+    for (int k = 0; k < A.outerSize(); ++k) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(A, k); it; ++it) {
+            int row = freeIndices[it.row()];
+            if (-1 == row)
+                continue;
+            int col = freeIndices[it.col()];
+            if (-1 == col)
+                rhs.row(row) -= it.value() * X.row(it.col());
+            else
+                triplets.push_back(Eigen::Triplet<double>(row, col, it.value()));
+        }
+    }
+    Eigen::SparseMatrix<double> system(freeNum, freeNum);
+    system.setFromTriplets(triplets.begin(), triplets.end());
+    IterativeSolver solver;
+    solver.setTolerance(m_options.tolerance);
+    solver.compute(system);
+    if (Eigen::Success != solver.info())
+        return false;
+    for (int c = 0; c < X.cols(); ++c) {
+        Eigen::VectorXd x = solver.solve(rhs.col(c));
+        // Running out of iterations still leaves a finite, but far from minimal, guess
+        if (Eigen::Success != solver.info())
+            return false;
+        for (int i = 0; i < n; ++i) {
+            if (-1 != freeIndices[i])
+                X(i, c) = x(freeIndices[i]);
+        }
+    }
+    return true;
+}
+
+bool ArapSolver::solveHarmonic(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+    const Eigen::VectorXi &bnd, const Eigen::MatrixXd &bndUv, Eigen::MatrixXd &U)
+{
+    Eigen::SparseMatrix<double> L;
+    m_laplacian.assemble(V, F, L);
+    if (!useIterative(F, L))
+        return igl::harmonic(L, Eigen::SparseMatrix<double>(), bnd, bndUv, 1, U);
+    // The Dirichlet energy is -L
+    Eigen::SparseMatrix<double> A = -L;
+    return solveIterativeWithFixed(A, bnd, bndUv, U);
+}
+
+bool ArapSolver::solveLscm(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+    const Eigen::VectorXi &b, const Eigen::MatrixXd &bc, Eigen::MatrixXd &U)
+{
+    // The u and v of every vertex stacked in one vector, the conformal energy couples them along the boundary
+    Eigen::SparseMatrix<double> vectorArea;
+    igl::vector_area_matrix(F, vectorArea);
+    Eigen::SparseMatrix<double> L;
+    m_laplacian.assemble(V, F, L);
+    Eigen::SparseMatrix<double> flatL;
+    igl::repdiag(L, 2, flatL);
+    Eigen::SparseMatrix<double> Q = -flatL + 2. * vectorArea;
+    int n = V.rows();
+    Eigen::VectorXi flatB(b.size() * 2);
+    Eigen::VectorXd flatBc(b.size() * 2);
+    for (int c = 0; c < 2; ++c) {
+        flatB.segment(c * b.size(), b.size()) = b.array() + c * n;
+        flatBc.segment(c * b.size(), b.size()) = bc.col(c);
+    }
+    Eigen::MatrixXd W;
+    if (useIterative(F, Q)) {
+        if (!solveIterativeWithFixed(Q, flatB, flatBc, W))
+            return false;
+    } else {
+        igl::min_quad_with_fixed_data<double> data;
+        if (!igl::min_quad_with_fixed_precompute(Q, flatB, Eigen::SparseMatrix<double>(), true, data))
+            return false;
+        if (!igl::min_quad_with_fixed_solve(data, Eigen::VectorXd::Zero(n * 2), flatBc, Eigen::VectorXd(), W))
+            return false;
+    }
+    // Swapped like igl::lscm
+    U.resize(n, 2);
+    for (int c = 0; c < 2; ++c)
+        U.col(1 - c) = W.block(c * n, 0, n, 1);
+    return true;
+}
+
+// Float can't push the relative residual of these systems much below this, a solve that still doesn't get there
+// within the iteration limit has stalled
+static const double kSingleTolerance = 1e-5;
+static const int kSingleMaxIterationNum = 1000;
+
+template <class Scalar>
+void ArapSolver::buildOperators(ArapOperators<Scalar> &operators)
+{
+    // The triangles are laid flat one by one, rotations are fitted per triangle
+    Eigen::MatrixXd planeV;
+    Eigen::MatrixXi planeF;
+    Eigen::SparseMatrix<double> refMap, refMapDim;
+    igl::project_isometrically_to_plane(m_vertices, m_faces, planeV, planeF, refMap);
+    igl::repdiag(refMap, 2, refMapDim);
+    Eigen::SparseMatrix<double> covarianceScatter;
+    igl::covariance_scatter_matrix(planeV, planeF, igl::ARAP_ENERGY_TYPE_ELEMENTS, covarianceScatter);
+    operators.covarianceScatter = (covarianceScatter * refMapDim.transpose()).template cast<Scalar>();
+    Eigen::SparseMatrix<double> rhs;
+    igl::arap_rhs(planeV, planeF, 2, igl::ARAP_ENERGY_TYPE_ELEMENTS, rhs);
+    operators.rhs = (refMapDim * rhs).template cast<Scalar>();
+
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> V = m_vertices.cast<Scalar>();
+    Eigen::SparseMatrix<Scalar> L;
+    m_laplacian.assemble(V, m_faces, L);
+    igl::massmatrix(V, m_faces, igl::MASSMATRIX_TYPE_DEFAULT, operators.mass);
+    // Halved like igl::min_quad_with_fixed does, which solves for the minimum of x'Ax/2 + x'B
+    Eigen::SparseMatrix<Scalar> Q = (-L).eval();
+    Q += operators.mass;
+    operators.system = Scalar(0.5) * Q;
+}
+
+bool ArapSolver::prepareDoublePrecision()
+{
+    if (m_doublePrecisionReady)
+        return true;
+    buildOperators(m_operators);
+    m_operators.iterative = useIterative(m_faces, m_operators.system);
+    if (m_operators.iterative) {
+        m_operators.conjugateGradient.setTolerance(m_options.tolerance);
+        m_operators.conjugateGradient.compute(m_operators.system);
+        m_doublePrecisionReady = Eigen::Success == m_operators.conjugateGradient.info();
+    } else {
+        m_operators.direct.compute(m_operators.system);
+        m_doublePrecisionReady = Eigen::Success == m_operators.direct.info();
+    }
+    return m_doublePrecisionReady;
+}
+
+bool ArapSolver::precompute(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+{
+    m_vertices = V;
+    m_faces = F;
+    m_singlePrecision = false;
+    m_doublePrecisionReady = false;
+    if (m_options.singlePrecision) {
+        // The double operators are only built if the float iteration has to hand over
+        buildOperators(m_singleOperators);
+        m_singleOperators.iterative = true;
+        m_singleOperators.conjugateGradient.setTolerance(std::max(m_options.tolerance, kSingleTolerance));
+        m_singleOperators.conjugateGradient.setMaxIterations(kSingleMaxIterationNum);
+        m_singleOperators.conjugateGradient.compute(m_singleOperators.system);
+        m_singlePrecision = Eigen::Success == m_singleOperators.conjugateGradient.info();
+        if (m_singlePrecision)
+            return true;
+    }
+    return prepareDoublePrecision();
+}
+
+bool ArapSolver::isIterative() const
+{
+    return m_singlePrecision || m_operators.iterative;
+}
+
+bool ArapSolver::isSinglePrecision() const
+{
+    return m_singlePrecision;
+}
+
+template <class Scalar>
+void ArapSolver::localStep(const ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &U,
+    const typename ArapOperators<Scalar>::Matrix &dynamics, typename ArapOperators<Scalar>::Matrix &B) const
+{
+    typedef typename ArapOperators<Scalar>::Matrix Matrix;
+    typedef typename ArapOperators<Scalar>::Vector Vector;
+    int n = operators.system.rows();
+    Matrix S = operators.covarianceScatter * U.replicate(2, 1);
+    S /= S.array().abs().maxCoeff();
+    Matrix R(2, operators.covarianceScatter.rows());
+    igl::fit_rotations_planar(S, R);
+    Vector Rcol;
+    igl::columnize(R, operators.rhs.cols() / 4, 2, Rcol);
+    Vector Bcol = -operators.rhs * Rcol;
+    B.resize(n, 2);
+    for (int c = 0; c < 2; ++c) {
+        B.col(c) = Bcol.segment(c * n, n);
+        B.col(c) += dynamics.col(c);
+    }
+}
+
+template <class Scalar>
+bool ArapSolver::globalStep(ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &B,
+    typename ArapOperators<Scalar>::Matrix &U) const
+{
+    typedef typename ArapOperators<Scalar>::Vector Vector;
+    for (int c = 0; c < 2; ++c) {
+        Vector Bc = B.col(c);
+        if (operators.iterative) {
+            Vector guess = U.col(c);
+            U.col(c) = operators.conjugateGradient.solveWithGuess(Bc * Scalar(-0.5), guess);
+            if (Eigen::Success != operators.conjugateGradient.info())
+                return false;
+        } else {
+            Vector x = operators.direct.solve(Bc);
+            x *= Scalar(-0.5);
+            U.col(c) = x;
+        }
+    }
+    return true;
+}
+
+template <class Scalar>
+double ArapSolver::calculateEnergy(const ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &U,
+    const typename ArapOperators<Scalar>::Matrix &B) const
+{
+    double energy = 0;
+    for (int c = 0; c < 2; ++c)
+        energy += U.col(c).dot(operators.system * U.col(c) + B.col(c));
+    return energy;
+}
+
+bool ArapSolver::isConverged(double energy, double nextEnergy) const
+{
+    return m_options.energyTolerance > 0 && energy - nextEnergy <= m_options.energyTolerance * std::abs(energy);
+}
+
+template <class Scalar>
+bool ArapSolver::iterate(ArapOperators<Scalar> &operators, typename ArapOperators<Scalar>::Matrix &U,
+    const typename ArapOperators<Scalar>::Matrix &dynamics, int &iterationNum)
+{
+    if (m_options.andersonWindow > 0)
+        return iterateAccelerated(operators, U, dynamics, iterationNum);
+    typename ArapOperators<Scalar>::Matrix B;
+    double energy = 0;
+    for (int iteration = 0; iterationNum > 0; ++iteration) {
+        localStep(operators, U, dynamics, B);
+        if (m_options.energyTolerance > 0) {
+            double currentEnergy = calculateEnergy(operators, U, B);
+            if (iteration > 0 && isConverged(energy, currentEnergy))
+                break;
+            energy = currentEnergy;
+        }
+        typename ArapOperators<Scalar>::Matrix next = U;
+        if (!globalStep(operators, B, next))
+            return false;
+        U = next;
+        --iterationNum;
+    }
+    return true;
+}
+
+// Anderson acceleration of the fixed point U = G(U), G being one local/global step as in
+// Peng et al. 2018, Anderson Acceleration for Geometry Optimization and Physics Simulation
+template <class Scalar>
+bool ArapSolver::iterateAccelerated(ArapOperators<Scalar> &operators, typename ArapOperators<Scalar>::Matrix &U,
+    const typename ArapOperators<Scalar>::Matrix &dynamics, int &iterationNum)
+{
+    typedef typename ArapOperators<Scalar>::Matrix Matrix;
+    typedef typename ArapOperators<Scalar>::Vector Vector;
+    int window = m_options.andersonWindow;
+    Eigen::Index size = U.size();
+    Matrix residualDifferences(size, window);
+    Matrix plainDifferences(size, window);
+    Vector previousResidual(size);
+    Matrix previousPlain;
+    bool hasPrevious = false;
+    int historyNum = 0;
+    int historyHead = 0;
+    Matrix B;
+    localStep(operators, U, dynamics, B);
+    double energy = calculateEnergy(operators, U, B);
+    while (iterationNum > 0) {
+        Matrix plain = U;
+        if (!globalStep(operators, B, plain))
+            return false;
+        --iterationNum;
+        Eigen::Map<const Vector> plainVector(plain.data(), size);
+        Vector residual = plainVector - Eigen::Map<const Vector>(U.data(), size);
+        if (hasPrevious) {
+            residualDifferences.col(historyHead) = residual - previousResidual;
+            plainDifferences.col(historyHead) = plainVector - Eigen::Map<const Vector>(previousPlain.data(), size);
+            historyHead = (historyHead + 1) % window;
+            historyNum = std::min(historyNum + 1, window);
+        }
+        previousResidual = residual;
+        previousPlain = plain;
+        hasPrevious = true;
+
+        Matrix next = plain;
+        if (historyNum > 0) {
+            Vector weights = residualDifferences.leftCols(historyNum).colPivHouseholderQr().solve(residual);
+            Eigen::Map<Vector>(next.data(), size) -= plainDifferences.leftCols(historyNum) * weights;
+        }
+        localStep(operators, next, dynamics, B);
+        double nextEnergy = calculateEnergy(operators, next, B);
+        if (historyNum > 0 && !(nextEnergy <= energy)) {
+            // The plain step never increases the energy
+            next = plain;
+            localStep(operators, next, dynamics, B);
+            nextEnergy = calculateEnergy(operators, next, B);
+            historyNum = 0;
+            historyHead = 0;
+            hasPrevious = false;
+        }
+        U = next;
+        bool converged = isConverged(energy, nextEnergy);
+        energy = nextEnergy;
+        if (converged)
+            break;
+    }
+    return true;
+}
+
+bool ArapSolver::solve(Eigen::MatrixXd &U)
+{
+    if (U.rows() != m_vertices.rows() || U.cols() != 2)
+        return false;
+    int iterationNum = m_options.iterationNum;
+    // The dynamic term pulls towards the initial guess, so it's fixed for the whole solve
+    Eigen::MatrixXd initialU = U;
+    if (m_singlePrecision) {
+        Eigen::MatrixXf singleU = U.cast<float>();
+        Eigen::MatrixXf singleDynamics = m_singleOperators.mass * (-singleU);
+        bool finished = iterate(m_singleOperators, singleU, singleDynamics, iterationNum);
+        U = singleU.cast<double>();
+        if (finished)
+            return true;
+        // Carry on in double from the last float iterate
+        m_singlePrecision = false;
+        if (!prepareDoublePrecision())
+            return false;
+    }
+    Eigen::MatrixXd dynamics = m_operators.mass * (-initialU);
+    return iterate(m_operators, U, dynamics, iterationNum);
+}
+
+}
@@ -0,0 +1,132 @@
+#ifndef SIMPLEUV_ARAP_SOLVER_H
+#define SIMPLEUV_ARAP_SOLVER_H
+#include <cstdlib>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/IterativeLinearSolvers>
+#include <simpleuv/vertexordering.h>
+#include <simpleuv/cotangentlaplacian.h>
+
+namespace simpleuv
+{
+
+enum class LinearSolver
+{
+    // Direct unless the factor is estimated to take more than the memory budget
+    Automatic,
+    // Sparse Cholesky factorization, computed once and reused by every iteration
+    Direct,
+    // Conjugate gradients with an incomplete Cholesky preconditioner, warm started from the previous iterate
+    Iterative
+};
+
+struct ArapOptions
+{
+    LinearSolver linearSolver = LinearSolver::Automatic;
+    // Bytes one island's factor may take before Automatic goes iterative
+    size_t memoryBudget = (size_t)1 << 30;
+    int iterationNum = 100;
+    // Relative residual the iterative solves stop at
+    double tolerance = 1e-10;
+    // The island vertices are renumbered with this before anything is built on them, the uvs come back in the original order.
+    // Other orderings also move where the boundary loop starts, so the initial guess and the uvs change with them
+    VertexOrdering vertexOrdering = VertexOrdering::Natural;
+    // Anderson acceleration of the local/global iteration over this many previous iterates, 0 turns it off.
+    // An accelerated step that doesn't lower the energy is replaced with the plain step and the history restarts
+    int andersonWindow = 0;
+    // Stop once an iteration lowers the energy by less than this fraction of it, 0 always runs iterationNum iterations
+    double energyTolerance = 0;
+    // Assemble and iterate in float with the iterative global step. When a float solve stops converging
+    // the remaining iterations continue in double from the last float iterate, through the backend linearSolver picks
+    bool singlePrecision = false;
+    // Threads assembling the Laplacian of large islands, 0 means one per hardware thread.
+    // UvUnwrapper always uses 1, its islands are solved in parallel already
+    size_t threadNum = 0;
+};
+
+template <class Scalar>
+struct ArapOperators
+{
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+    Eigen::SparseMatrix<Scalar> system;
+    Eigen::SparseMatrix<Scalar> mass;
+    Eigen::SparseMatrix<Scalar> rhs;
+    Eigen::SparseMatrix<Scalar> covarianceScatter;
+    bool iterative = false;
+    Eigen::SimplicialLLT<Eigen::SparseMatrix<Scalar>> direct;
+    Eigen::ConjugateGradient<Eigen::SparseMatrix<Scalar>, Eigen::Lower | Eigen::Upper,
+        Eigen::IncompleteCholesky<Scalar>> conjugateGradient;
+};
+
+// The energy, the per triangle rotations and the dynamic regularization are the same as igl::arap_solve with
+// with_dynamics solving in 2d, only the global step's linear solves are done here so the backend can change
+class ArapSolver
+{
+public:
+    explicit ArapSolver(const ArapOptions &options=ArapOptions());
+    bool precompute(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F);
+    // U is the initial guess and receives the result. False when a double global step doesn't converge,
+    // U then holds the last iterate before it
+    bool solve(Eigen::MatrixXd &U);
+    // The harmonic map with the boundary vertices fixed at bndUv, through the same backend choice
+    bool solveHarmonic(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+        const Eigen::VectorXi &bnd, const Eigen::MatrixXd &bndUv, Eigen::MatrixXd &U);
+    // Same as igl::lscm with the vertices b pinned at bc, but conjugate gradients past the memory budget too
+    bool solveLscm(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+        const Eigen::VectorXi &b, const Eigen::MatrixXd &bc, Eigen::MatrixXd &U);
+    bool isIterative() const;
+    // Whether the last solve stayed in float all the way
+    bool isSinglePrecision() const;
+    // Bytes of the sparse Cholesky factor of the symmetric matrix with the AMD ordering, from the elimination tree
+    // column counts only, so it takes time proportional to the factor but no more memory than the matrix
+    static size_t estimateFactorBytes(const Eigen::SparseMatrix<double> &matrix);
+private:
+    typedef Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower | Eigen::Upper,
+        Eigen::IncompleteCholesky<double>> IterativeSolver;
+    // The Laplacian and the ARAP system have the same pattern, so the decision made for one is kept for the other
+    bool useIterative(const Eigen::MatrixXi &F, const Eigen::SparseMatrix<double> &matrix);
+    // Minimizes the trace of X'AX with the rows known of X fixed at knownValues, one conjugate gradient solve per column
+    bool solveIterativeWithFixed(const Eigen::SparseMatrix<double> &A, const Eigen::VectorXi &known,
+        const Eigen::MatrixXd &knownValues, Eigen::MatrixXd &X) const;
+    template <class Scalar>
+    void buildOperators(ArapOperators<Scalar> &operators);
+    bool prepareDoublePrecision();
+    // Fits the rotations to U and gives the right hand side of the global step, one column per uv coordinate
+    template <class Scalar>
+    void localStep(const ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &U,
+        const typename ArapOperators<Scalar>::Matrix &dynamics, typename ArapOperators<Scalar>::Matrix &B) const;
+    // U is the warm start of the iterative backend and receives the minimizer, false when the iterative solve didn't converge
+    template <class Scalar>
+    bool globalStep(ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &B,
+        typename ArapOperators<Scalar>::Matrix &U) const;
+    // The energy up to a constant, U'AU + U'B, with B from localStep(U)
+    template <class Scalar>
+    double calculateEnergy(const ArapOperators<Scalar> &operators, const typename ArapOperators<Scalar>::Matrix &U,
+        const typename ArapOperators<Scalar>::Matrix &B) const;
+    bool isConverged(double energy, double nextEnergy) const;
+    // Runs up to iterationNum iterations and counts them off. Returns false, with U at the last good iterate,
+    // when a global step doesn't converge
+    template <class Scalar>
+    bool iterate(ArapOperators<Scalar> &operators, typename ArapOperators<Scalar>::Matrix &U,
+        const typename ArapOperators<Scalar>::Matrix &dynamics, int &iterationNum);
+    template <class Scalar>
+    bool iterateAccelerated(ArapOperators<Scalar> &operators, typename ArapOperators<Scalar>::Matrix &U,
+        const typename ArapOperators<Scalar>::Matrix &dynamics, int &iterationNum);
+    ArapOptions m_options;
+    CotangentLaplacian m_laplacian;
+    Eigen::MatrixXi m_decidedFaces;
+    int m_decidedSize = -1;
+    bool m_decidedIterative = false;
+    Eigen::MatrixXd m_vertices;
+    Eigen::MatrixXi m_faces;
+    bool m_singlePrecision = false;
+    bool m_doublePrecisionReady = false;
+    ArapOperators<double> m_operators;
+    ArapOperators<float> m_singleOperators;
+};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Geometry>
+#include <igl/boundary_loop.h>
+#include <igl/PI.h>
+#include <simpleuv/boundaryfirstflattening.h>
+
+namespace simpleuv
+{
+
+void BoundaryFirstFlattening::setThreadNum(size_t threadNum)
+{
+    m_laplacian.setThreadNum(threadNum);
+}
+
+bool BoundaryFirstFlattening::precompute(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd)
+{
+    m_vertexNum = V.rows();
+    m_boundary = bnd;
+    int boundaryNum = bnd.size();
+    if (boundaryNum < 3)
+        return false;
+
+    // Holes would need their own closing conditions, those islands are left to the other methods
+    std::vector<std::vector<int>> loops;
+    igl::boundary_loop(F, loops);
+    if (1 != loops.size() || (int)loops[0].size() != boundaryNum)
+        return false;
+
+    m_indices.assign(m_vertexNum, 0);
+    for (int i = 0; i < boundaryNum; ++i)
+        m_indices[bnd(i)] = -1;
+    m_interiorVertices.clear();
+    for (int v = 0; v < m_vertexNum; ++v) {
+        if (-1 == m_indices[v])
+            continue;
+        m_indices[v] = m_interiorVertices.size();
+        m_interiorVertices.push_back(v);
+    }
+    int interiorNum = m_interiorVertices.size();
+    for (int i = 0; i < boundaryNum; ++i)
+        m_indices[bnd(i)] = interiorNum + i;
+
+    // The positive semidefinite Laplacian split into the interior and boundary blocks
+    Eigen::SparseMatrix<double> L;
+    m_laplacian.assemble(V, F, L);
+    std::vector<Eigen::Triplet<double>> interiorTriplets;
+    std::vector<Eigen::Triplet<double>> interiorBoundaryTriplets;
+    std::vector<Eigen::Triplet<double>> boundaryBoundaryTriplets;
+    interiorTriplets.reserve(L.nonZeros());
+    for (int k = 0; k < L.outerSize(); ++k) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(L, k); it; ++it) {
+            int row = m_indices[it.row()];
+            int col = m_indices[it.col()];
+            if (row < interiorNum) {
+                if (col < interiorNum)
+                    interiorTriplets.push_back(Eigen::Triplet<double>(row, col, -it.value()));
+                else
+                    interiorBoundaryTriplets.push_back(Eigen::Triplet<double>(row, col - interiorNum, -it.value()));
+            } else if (col >= interiorNum) {
+                boundaryBoundaryTriplets.push_back(Eigen::Triplet<double>(row - interiorNum, col - interiorNum, -it.value()));
+            }
+        }
+    }
+    m_interiorBlock.resize(interiorNum, interiorNum);
+    m_interiorBlock.setFromTriplets(interiorTriplets.begin(), interiorTriplets.end());
+    m_interiorBoundaryBlock.resize(interiorNum, boundaryNum);
+    m_interiorBoundaryBlock.setFromTriplets(interiorBoundaryTriplets.begin(), interiorBoundaryTriplets.end());
+    m_boundaryBoundaryBlock.resize(boundaryNum, boundaryNum);
+    m_boundaryBoundaryBlock.setFromTriplets(boundaryBoundaryTriplets.begin(), boundaryBoundaryTriplets.end());
+
+    std::vector<double> angleSums(m_vertexNum, 0.0);
+    for (int f = 0; f < F.rows(); ++f) {
+        for (int a = 0; a < 3; ++a) {
+            Eigen::Vector3d p = V.row(F(f, a)).transpose();
+            Eigen::Vector3d u = V.row(F(f, (a + 1) % 3)).transpose() - p;
+            Eigen::Vector3d w = V.row(F(f, (a + 2) % 3)).transpose() - p;
+            angleSums[F(f, a)] += std::atan2(u.cross(w).norm(), u.dot(w));
+        }
+    }
+    m_interiorCurvatures.resize(interiorNum);
+    for (int i = 0; i < interiorNum; ++i)
+        m_interiorCurvatures(i) = 2 * igl::PI - angleSums[m_interiorVertices[i]];
+    m_boundaryCurvatures.resize(boundaryNum);
+    m_boundaryEdgeLengths.resize(boundaryNum);
+    for (int i = 0; i < boundaryNum; ++i) {
+        m_boundaryCurvatures(i) = igl::PI - angleSums[bnd(i)];
+        m_boundaryEdgeLengths(i) = (V.row(bnd((i + 1) % boundaryNum)) - V.row(bnd(i))).norm();
+    }
+
+    if (0 == interiorNum)
+        return true;
+    m_factorization.compute(m_interiorBlock);
+    return Eigen::Success == m_factorization.info();
+}
+
+bool BoundaryFirstFlattening::flatten(const Eigen::VectorXd &boundaryScaleFactors, Eigen::MatrixXd &U)
+{
+    int interiorNum = m_interiorVertices.size();
+    int boundaryNum = m_boundary.size();
+    if (boundaryScaleFactors.size() != boundaryNum)
+        return false;
+
+    // Dirichlet to Neumann: the interior scale factors flatten the interior, what their normal derivative
+    // adds to the boundary curvature makes the turning angles of the flat boundary
+    Eigen::VectorXd interiorScaleFactors;
+    if (interiorNum > 0) {
+        interiorScaleFactors = m_factorization.solve(-m_interiorCurvatures - m_interiorBoundaryBlock * boundaryScaleFactors);
+        if (Eigen::Success != m_factorization.info())
+            return false;
+    }
+    Eigen::VectorXd turningAngles = m_boundaryCurvatures + m_boundaryBoundaryBlock * boundaryScaleFactors;
+    double minScaleFactor = boundaryScaleFactors.minCoeff();
+    double maxScaleFactor = boundaryScaleFactors.maxCoeff();
+    if (interiorNum > 0) {
+        turningAngles += m_interiorBoundaryBlock.transpose() * interiorScaleFactors;
+        minScaleFactor = std::min(minScaleFactor, interiorScaleFactors.minCoeff());
+        maxScaleFactor = std::max(maxScaleFactor, interiorScaleFactors.maxCoeff());
+    }
+    m_areaDistortion = std::exp(2 * (maxScaleFactor - minScaleFactor));
+
+    Eigen::VectorXd lengths(boundaryNum);
+    Eigen::Matrix2Xd tangents(2, boundaryNum);
+    double angle = 0;
+    for (int i = 0; i < boundaryNum; ++i) {
+        if (i > 0)
+            angle += turningAngles(i);
+        lengths(i) = std::exp(0.5 * (boundaryScaleFactors(i) + boundaryScaleFactors((i + 1) % boundaryNum))) *
+            m_boundaryEdgeLengths(i);
+        tangents.col(i) << std::cos(angle), std::sin(angle);
+    }
+
+    // The smallest change of the lengths, weighted by their inverse, that closes the curve
+    Eigen::Matrix2d mass = tangents * lengths.asDiagonal() * tangents.transpose();
+    if (std::abs(mass.determinant()) <= 1e-12 * mass.squaredNorm())
+        return false;
+    Eigen::Vector2d gap = tangents * lengths;
+    Eigen::VectorXd closedLengths = lengths - lengths.asDiagonal() * (tangents.transpose() * mass.inverse() * gap);
+    if (closedLengths.minCoeff() <= 0)
+        return false;
+
+    Eigen::MatrixXd boundaryUv(boundaryNum, 2);
+    boundaryUv.row(0).setZero();
+    for (int i = 1; i < boundaryNum; ++i)
+        boundaryUv.row(i) = boundaryUv.row(i - 1) + closedLengths(i - 1) * tangents.col(i - 1).transpose();
+
+    U.resize(m_vertexNum, 2);
+    for (int i = 0; i < boundaryNum; ++i)
+        U.row(m_boundary(i)) = boundaryUv.row(i);
+    if (interiorNum > 0) {
+        Eigen::MatrixXd interiorUv = m_factorization.solve(-(m_interiorBoundaryBlock * boundaryUv));
+        if (Eigen::Success != m_factorization.info())
+            return false;
+        for (int i = 0; i < interiorNum; ++i)
+            U.row(m_interiorVertices[i]) = interiorUv.row(i);
+    }
+    return true;
+}
+
+double BoundaryFirstFlattening::getAreaDistortion() const
+{
+    return m_areaDistortion;
+}
+
+bool BoundaryFirstFlattening::flatten(Eigen::MatrixXd &U)
+{
+    return flatten(Eigen::VectorXd::Zero(m_boundary.size()), U);
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef SIMPLEUV_BOUNDARY_FIRST_FLATTENING_H
+#define SIMPLEUV_BOUNDARY_FIRST_FLATTENING_H
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <simpleuv/cotangentlaplacian.h>
+
+namespace simpleuv
+{
+
+// Conformal flattening of a disk with a free boundary, after Boundary First Flattening (Sawhney and Crane 2017).
+// The scale factors on the boundary are chosen, a Poisson solve turns them into the boundary curvature of the
+// flattened map, the boundary curve is built from those and closed, and the interior is its harmonic extension.
+// Both solves are on the interior block of the cotangent Laplacian, which is factored once in precompute
+class BoundaryFirstFlattening
+{
+public:
+    // Threads assembling the Laplacian of large meshes, 0 means one per hardware thread
+    void setThreadNum(size_t threadNum);
+    // bnd is the boundary loop, false when the mesh has any other boundary or the factorization fails
+    bool precompute(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd);
+    // Log of how much each boundary vertex gets scaled, zeros give the least area distortion.
+    // U receives the uv of every vertex
+    bool flatten(const Eigen::VectorXd &boundaryScaleFactors, Eigen::MatrixXd &U);
+    bool flatten(Eigen::MatrixXd &U);
+    // Ratio of the largest to the smallest area scale of the last flatten, conformal maps of long or
+    // strongly curved islands can shrink parts of them to nothing
+    double getAreaDistortion() const;
+private:
+    int m_vertexNum = 0;
+    Eigen::VectorXi m_boundary;
+    // Interior vertices are numbered first, then the boundary vertices in loop order
+    std::vector<int> m_indices;
+    std::vector<int> m_interiorVertices;
+    Eigen::SparseMatrix<double> m_interiorBlock;
+    Eigen::SparseMatrix<double> m_interiorBoundaryBlock;
+    Eigen::SparseMatrix<double> m_boundaryBoundaryBlock;
+    // Angle defects of the interior vertices and the turning angles at the boundary vertices
+    Eigen::VectorXd m_interiorCurvatures;
+    Eigen::VectorXd m_boundaryCurvatures;
+    Eigen::VectorXd m_boundaryEdgeLengths;
+    double m_areaDistortion = 1;
+    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> m_factorization;
+    CotangentLaplacian m_laplacian;
+};
+
+}
+
+#endif
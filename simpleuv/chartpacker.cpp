@@ -1,5 +1,7 @@
 #include <simpleuv/chartpacker.h>
+#include <simpleuv/skylinepacker.h>
 #include <cmath>
+#include <algorithm>
 extern "C" {
 #include <maxrects.h>
 }
@@ -12,11 +14,42 @@ void ChartPacker::setCharts(const std::vector<std::pair<float, float>> &chartSiz
     m_chartSizes = chartSizes;
 }
 
+void ChartPacker::setMethod(Method method)
+{
+    m_method = method;
+}
+
+void ChartPacker::setPageSize(float pageSize)
+{
+    m_pageSize = pageSize;
+}
+
 const std::vector<std::tuple<float, float, float, float, bool>> &ChartPacker::getResult()
 {
     return m_result;
 }
 
+const std::vector<int> &ChartPacker::getResultPages()
+{
+    return m_resultPages;
+}
+
+void ChartPacker::setTexelResolution(int resolution, int paddingPixels)
+{
+    m_texelResolution = resolution;
+    m_texelPaddingPixels = paddingPixels;
+}
+
+const std::vector<PixelRect> &ChartPacker::getResultPixelRects()
+{
+    return m_resultPixelRects;
+}
+
+size_t ChartPacker::getPageNum()
+{
+    return m_pageNum;
+}
+
 double ChartPacker::calculateTotalArea()
 {
     double totalArea = 0;
@@ -26,22 +59,16 @@ double ChartPacker::calculateTotalArea()
     return totalArea;
 }
 
-bool ChartPacker::tryPack(float textureSize)
+bool ChartPacker::layoutRects(int width, int height, const std::vector<std::pair<int, int>> &rects,
+    std::vector<std::tuple<int, int, bool>> &layout)
 {
-    std::vector<maxRectsSize> rects;
-    int width = textureSize * m_floatToIntFactor;
-    int height = width;
-    //if (m_tryNum > 50) {
-    //    qDebug() << "Try the " << m_tryNum << "nth times pack with factor:" << m_textureSizeFactor << " size:" << width << "x" << height;
-    //}
-    float paddingSize = m_paddingSize * width;
-    float paddingSize2 = paddingSize + paddingSize;
-    for (const auto &chartSize: m_chartSizes) {
-        maxRectsSize r;
-        r.width = chartSize.first * m_floatToIntFactor + paddingSize2;
-        r.height = chartSize.second * m_floatToIntFactor + paddingSize2;
-        //qDebug() << "  :chart " << r.width << "x" << r.height;
-        rects.push_back(r);
+    if (Method::Skyline == m_method)
+        return skylinePack(width, height, rects, true, layout);
+    std::vector<maxRectsSize> maxRectsSizes(rects.size());
+    for (size_t i = 0; i < rects.size(); ++i) {
+        maxRectsSizes[i].width = rects[i].first;
+        maxRectsSizes[i].height = rects[i].second;
+        //qDebug() << "  :chart " << rects[i].first << "x" << rects[i].second;
     }
     const maxRectsFreeRectChoiceHeuristic methods[] = {
         rectBestShortSideFit,
@@ -56,7 +83,7 @@ bool ChartPacker::tryPack(float textureSize)
     for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
         //qDebug() << "Test method[" << methods[i] << "]";
         std::vector<maxRectsPosition> result(rects.size());
-        if (0 != maxRects(width, height, rects.size(), rects.data(), methods[i], true, result.data(), &occupancy)) {
+        if (0 != maxRects(width, height, maxRectsSizes.size(), maxRectsSizes.data(), methods[i], true, result.data(), &occupancy)) {
             //qDebug() << "  method[" << methods[i] << "] failed";
             continue;
         }
@@ -68,23 +95,181 @@ bool ChartPacker::tryPack(float textureSize)
     }
     if (bestResult.size() != rects.size())
         return false;
-    m_result.resize(bestResult.size());
-    for (decltype(bestResult.size()) i = 0; i < bestResult.size(); ++i) {
-        const auto &result = bestResult[i];
+    layout.resize(bestResult.size());
+    for (size_t i = 0; i < bestResult.size(); ++i)
+        layout[i] = std::make_tuple(bestResult[i].left, bestResult[i].top, 0 != bestResult[i].rotated);
+    return true;
+}
+
+bool ChartPacker::tryPack(float textureSize)
+{
+    int width = textureSize * m_floatToIntFactor;
+    int height = width;
+    //if (m_tryNum > 50) {
+    //    qDebug() << "Try the " << m_tryNum << "nth times pack with factor:" << m_textureSizeFactor << " size:" << width << "x" << height;
+    //}
+    float paddingSize = m_paddingSize * width;
+    float paddingSize2 = paddingSize + paddingSize;
+    std::vector<std::pair<int, int>> rects;
+    rects.reserve(m_chartSizes.size());
+    for (const auto &chartSize: m_chartSizes) {
+        rects.push_back({(int)(chartSize.first * m_floatToIntFactor + paddingSize2),
+            (int)(chartSize.second * m_floatToIntFactor + paddingSize2)});
+    }
+    std::vector<std::tuple<int, int, bool>> layout;
+    if (!layoutRects(width, height, rects, layout))
+        return false;
+    m_result.resize(layout.size());
+    m_resultPages.assign(layout.size(), 0);
+    m_pageNum = 1;
+    for (size_t i = 0; i < layout.size(); ++i) {
         const auto &rect = rects[i];
         auto &dest = m_result[i];
-        std::get<0>(dest) = (float)(result.left + paddingSize) / width;
-        std::get<1>(dest) = (float)(result.top + paddingSize) / height;
-        std::get<2>(dest) = (float)(rect.width - paddingSize2) / width;
-        std::get<3>(dest) = (float)(rect.height - paddingSize2) / height;
-        std::get<4>(dest) = result.rotated;
+        std::get<0>(dest) = (float)(std::get<0>(layout[i]) + paddingSize) / width;
+        std::get<1>(dest) = (float)(std::get<1>(layout[i]) + paddingSize) / height;
+        std::get<2>(dest) = (float)(rect.first - paddingSize2) / width;
+        std::get<3>(dest) = (float)(rect.second - paddingSize2) / height;
+        std::get<4>(dest) = std::get<2>(layout[i]);
         //qDebug() << "result[" << i << "]:" << std::get<0>(dest) << std::get<1>(dest) << std::get<2>(dest) << std::get<3>(dest) << std::get<4>(dest);
     }
     return true;
 }
 
+bool ChartPacker::tryPackTexels(float pixelsPerUnit)
+{
+    // Every chart takes a whole number of texels plus the padding texels on each side,
+    // so the chart origins land exactly on texel corners of the final image
+    int resolution = m_texelResolution;
+    int paddingPixels2 = m_texelPaddingPixels + m_texelPaddingPixels;
+    std::vector<std::pair<int, int>> rects;
+    rects.reserve(m_chartSizes.size());
+    for (const auto &chartSize: m_chartSizes) {
+        int width = (int)std::ceil(chartSize.first * pixelsPerUnit) + paddingPixels2;
+        int height = (int)std::ceil(chartSize.second * pixelsPerUnit) + paddingPixels2;
+        if (std::max(width, height) > resolution)
+            return false;
+        rects.push_back({width, height});
+    }
+    std::vector<std::tuple<int, int, bool>> layout;
+    if (!layoutRects(resolution, resolution, rects, layout))
+        return false;
+    m_result.resize(layout.size());
+    m_resultPixelRects.resize(layout.size());
+    m_resultPages.assign(layout.size(), 0);
+    m_pageNum = 1;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        const auto &chartSize = m_chartSizes[i];
+        const auto &rect = rects[i];
+        int left = std::get<0>(layout[i]) + m_texelPaddingPixels;
+        int top = std::get<1>(layout[i]) + m_texelPaddingPixels;
+        bool rotated = std::get<2>(layout[i]);
+        int pixelWidth = rect.first - paddingPixels2;
+        int pixelHeight = rect.second - paddingPixels2;
+        if (rotated)
+            std::swap(pixelWidth, pixelHeight);
+        m_resultPixelRects[i] = {left, top, pixelWidth, pixelHeight, 0};
+        auto &dest = m_result[i];
+        std::get<0>(dest) = (float)left / resolution;
+        std::get<1>(dest) = (float)top / resolution;
+        std::get<2>(dest) = chartSize.first * pixelsPerUnit / resolution;
+        std::get<3>(dest) = chartSize.second * pixelsPerUnit / resolution;
+        std::get<4>(dest) = rotated;
+    }
+    return true;
+}
+
+float ChartPacker::packTexels()
+{
+    m_resultPixelRects.clear();
+    double totalArea = calculateTotalArea();
+    if (totalArea <= 0)
+        return 0;
+    float pixelsPerUnit = m_texelResolution / std::sqrt(totalArea * m_initialAreaGuessFactor);
+    while (true) {
+        ++m_tryNum;
+        if (tryPackTexels(pixelsPerUnit))
+            break;
+        pixelsPerUnit /= 1.0 + m_textureSizeGrowFactor;
+        if (m_tryNum >= m_maxTryNum) {
+            //qDebug() << "Tried too many times:" << m_tryNum;
+            break;
+        }
+    }
+    return m_texelResolution / pixelsPerUnit;
+}
+
+float ChartPacker::packPages()
+{
+    // One skyline pass per page over the charts left by the previous pages, largest first,
+    // charts bigger than a page are scaled down to fit one
+    int width = m_pageSize * m_floatToIntFactor;
+    int height = width;
+    float paddingSize = m_paddingSize * width;
+    float paddingSize2 = paddingSize + paddingSize;
+    float maxChartSize = (width - paddingSize2) / m_floatToIntFactor;
+    std::vector<std::pair<float, float>> chartSizes(m_chartSizes);
+    for (auto &chartSize: chartSizes) {
+        float longSide = std::max(chartSize.first, chartSize.second);
+        if (longSide > maxChartSize) {
+            float scale = maxChartSize / longSide;
+            chartSize.first *= scale;
+            chartSize.second *= scale;
+        }
+    }
+    m_result.resize(chartSizes.size());
+    m_resultPages.resize(chartSizes.size());
+    m_pageNum = 0;
+    std::vector<size_t> remainingCharts(chartSizes.size());
+    for (size_t i = 0; i < remainingCharts.size(); ++i)
+        remainingCharts[i] = i;
+    while (!remainingCharts.empty()) {
+        std::vector<std::pair<int, int>> rects;
+        rects.reserve(remainingCharts.size());
+        for (const auto &chartIndex: remainingCharts) {
+            const auto &chartSize = chartSizes[chartIndex];
+            rects.push_back({(int)(chartSize.first * m_floatToIntFactor + paddingSize2),
+                (int)(chartSize.second * m_floatToIntFactor + paddingSize2)});
+        }
+        std::vector<std::tuple<int, int, bool>> layout;
+        std::vector<size_t> unfittedRects;
+        skylinePack(width, height, rects, true, layout, nullptr, &unfittedRects);
+        if (unfittedRects.size() == rects.size()) {
+            //qDebug() << "Chart doesn't fit an empty page";
+            m_result.clear();
+            m_resultPages.clear();
+            return m_pageSize;
+        }
+        std::vector<bool> unfitted(rects.size(), false);
+        for (const auto &rectIndex: unfittedRects)
+            unfitted[rectIndex] = true;
+        std::vector<size_t> nextRemainingCharts;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            size_t chartIndex = remainingCharts[i];
+            if (unfitted[i]) {
+                nextRemainingCharts.push_back(chartIndex);
+                continue;
+            }
+            const auto &rect = rects[i];
+            auto &dest = m_result[chartIndex];
+            std::get<0>(dest) = (float)(std::get<0>(layout[i]) + paddingSize) / width;
+            std::get<1>(dest) = (float)(std::get<1>(layout[i]) + paddingSize) / height;
+            std::get<2>(dest) = (float)(rect.first - paddingSize2) / width;
+            std::get<3>(dest) = (float)(rect.second - paddingSize2) / height;
+            std::get<4>(dest) = std::get<2>(layout[i]);
+            m_resultPages[chartIndex] = (int)m_pageNum;
+        }
+        remainingCharts.swap(nextRemainingCharts);
+        ++m_pageNum;
+    }
+    return m_pageSize;
+}
+
 float ChartPacker::pack()
 {
+    if (m_texelResolution > 0)
+        return packTexels();
+    if (m_pageSize > 0)
+        return packPages();
     float textureSize = 0;
     float initialGuessSize = std::sqrt(calculateTotalArea() * m_initialAreaGuessFactor);
     while (true) {
@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdlib>
 #include <tuple>
+#include <simpleuv/meshdatatype.h>
 
 namespace simpleuv
 {
@@ -10,16 +11,42 @@ namespace simpleuv
 class ChartPacker
 {
 public:
+    enum class Method
+    {
+        MaxRects,   // Best of the five maxrects heuristics, tightest but quadratic in the chart count
+        Skyline     // Skyline bottom left with the charts sorted by height, for very many charts
+    };
+
+    void setMethod(Method method);
+    // Pack into as many square pages of this size as needed instead of growing one texture, 0 turns it off
+    void setPageSize(float pageSize);
+    // Pack on a resolution x resolution texel grid with whole texel padding, the chart rects start on texel
+    // corners and getResultPixelRects() gives them in texels. Takes precedence over pages, 0 turns it off
+    void setTexelResolution(int resolution, int paddingPixels);
     void setCharts(const std::vector<std::pair<float, float>> &chartSizes);
     const std::vector<std::tuple<float, float, float, float, bool>> &getResult();
+    const std::vector<int> &getResultPages();
+    const std::vector<PixelRect> &getResultPixelRects();
+    size_t getPageNum();
     float pack();
     bool tryPack(float textureSize);
 
 private:
     double calculateTotalArea();
+    bool layoutRects(int width, int height, const std::vector<std::pair<int, int>> &rects,
+        std::vector<std::tuple<int, int, bool>> &layout);
+    float packPages();
+    bool tryPackTexels(float pixelsPerUnit);
+    float packTexels();
 
     std::vector<std::pair<float, float>> m_chartSizes;
     std::vector<std::tuple<float, float, float, float, bool>> m_result;
+    std::vector<int> m_resultPages;
+    size_t m_pageNum = 0;
+    float m_pageSize = 0;
+    std::vector<PixelRect> m_resultPixelRects;
+    int m_texelResolution = 0;
+    int m_texelPaddingPixels = 1;
     float m_initialAreaGuessFactor = 1.1;
     float m_textureSizeGrowFactor = 0.05;
     float m_floatToIntFactor = 10000;
@@ -27,6 +54,7 @@ private:
     float m_textureSizeFactor = 1.0;
     float m_paddingSize = 0.002;
     size_t m_maxTryNum = 100;
+    Method m_method = Method::MaxRects;
 };
 
 }
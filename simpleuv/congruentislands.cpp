@@ -0,0 +1,159 @@
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <simpleuv/congruentislands.h>
+#include <simpleuv/oppositefaces.h>
+
+namespace simpleuv
+{
+
+// Symmetric islands match from several seeds, a failed seed usually fails within a few faces
+const size_t kMaxMatchAttemptNum = 16;
+
+static float edgeLength(const CompactMesh &mesh, Index face, size_t corner)
+{
+    const auto &indices = mesh.faces[face].indices;
+    const auto &first = mesh.vertices[indices[corner]].xyz;
+    const auto &second = mesh.vertices[indices[(corner + 1) % 3]].xyz;
+    float x = second[0] - first[0];
+    float y = second[1] - first[1];
+    float z = second[2] - first[2];
+    return std::sqrt(x * x + y * y + z * z);
+}
+
+static size_t findCorner(const CompactMesh &mesh, Index face, Index vertex)
+{
+    const auto &indices = mesh.faces[face].indices;
+    for (size_t j = 0; j < 3; ++j) {
+        if (indices[j] == vertex)
+            return j;
+    }
+    return 3;
+}
+
+static uint64_t mixHash(uint64_t hash, uint64_t value)
+{
+    return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+uint64_t fingerprintIsland(const CompactMesh &mesh, const std::vector<Index> &island, float lengthQuantum)
+{
+    std::vector<int64_t> lengths(island.size() * 3);
+    for (size_t i = 0; i < island.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            lengths[i * 3 + j] = std::llround(edgeLength(mesh, island[i], j) / lengthQuantum);
+    }
+    std::sort(lengths.begin(), lengths.end());
+    uint64_t hash = mixHash(0, island.size());
+    for (const auto &length: lengths)
+        hash = mixHash(hash, (uint64_t)length);
+    return hash;
+}
+
+bool matchCongruentIsland(const CompactMesh &mesh, const std::vector<Index> &representative, std::vector<Index> &copy,
+    float lengthTolerance, std::vector<unsigned char> &cornerRotations)
+{
+    size_t faceNum = representative.size();
+    if (0 == faceNum || copy.size() != faceNum)
+        return false;
+    std::vector<Index> representativeOppositeFaces;
+    std::vector<Index> copyOppositeFaces;
+    buildOppositeFaces(mesh.faces, representative.data(), faceNum, representativeOppositeFaces);
+    buildOppositeFaces(mesh.faces, copy.data(), faceNum, copyOppositeFaces);
+
+    auto matchLengths = [&](Index representativeFace, Index copyFace, size_t rotation) {
+        for (size_t j = 0; j < 3; ++j) {
+            if (std::abs(edgeLength(mesh, representativeFace, j) - edgeLength(mesh, copyFace, (j + rotation) % 3)) > lengthTolerance)
+                return false;
+        }
+        return true;
+    };
+
+    // Grow the correspondence from the seed across the edges, every face is reached exactly once
+    std::vector<Index> copyFaces(faceNum);
+    std::vector<Index> representativeFaces(faceNum);
+    std::vector<unsigned char> rotations(faceNum);
+    std::vector<Index> waitFaces;
+    waitFaces.reserve(faceNum);
+    auto grow = [&](Index seed, size_t seedRotation) {
+        std::fill(copyFaces.begin(), copyFaces.end(), (Index)-1);
+        std::fill(representativeFaces.begin(), representativeFaces.end(), (Index)-1);
+        copyFaces[0] = seed;
+        representativeFaces[seed] = 0;
+        rotations[0] = seedRotation;
+        waitFaces.assign(1, 0);
+        for (size_t head = 0; head < waitFaces.size(); ++head) {
+            Index face = waitFaces[head];
+            Index copyFace = copyFaces[face];
+            size_t rotation = rotations[face];
+            for (size_t j = 0; j < 3; ++j) {
+                Index opposite = representativeOppositeFaces[face * 3 + j];
+                Index copyOpposite = copyOppositeFaces[copyFace * 3 + (j + rotation) % 3];
+                if (((Index)-1 == opposite) != ((Index)-1 == copyOpposite))
+                    return false;
+                if ((Index)-1 == opposite)
+                    continue;
+                // The opposite faces start their side of the edge at its second vertex
+                size_t corner = findCorner(mesh, representative[opposite],
+                    mesh.faces[representative[face]].indices[(j + 1) % 3]);
+                size_t copyCorner = findCorner(mesh, copy[copyOpposite],
+                    mesh.faces[copy[copyFace]].indices[(j + rotation + 1) % 3]);
+                if (3 == corner || 3 == copyCorner)
+                    return false;
+                size_t oppositeRotation = (copyCorner + 3 - corner) % 3;
+                if ((Index)-1 != copyFaces[opposite]) {
+                    if (copyFaces[opposite] != copyOpposite || rotations[opposite] != oppositeRotation)
+                        return false;
+                    continue;
+                }
+                if ((Index)-1 != representativeFaces[copyOpposite])
+                    return false;
+                if (!matchLengths(representative[opposite], copy[copyOpposite], oppositeRotation))
+                    return false;
+                copyFaces[opposite] = copyOpposite;
+                representativeFaces[copyOpposite] = opposite;
+                rotations[opposite] = oppositeRotation;
+                waitFaces.push_back(opposite);
+            }
+        }
+        if (waitFaces.size() != faceNum)
+            return false;
+
+        // Faces glued only at a vertex could still be paired up with different vertices
+        std::unordered_map<Index, Index> copyVertices;
+        std::unordered_map<Index, Index> representativeVertices;
+        for (size_t i = 0; i < faceNum; ++i) {
+            const auto &indices = mesh.faces[representative[i]].indices;
+            const auto &copyIndices = mesh.faces[copy[copyFaces[i]]].indices;
+            for (size_t j = 0; j < 3; ++j) {
+                Index vertex = indices[j];
+                Index copyVertex = copyIndices[(j + rotations[i]) % 3];
+                if (copyVertices.insert({vertex, copyVertex}).first->second != copyVertex ||
+                        representativeVertices.insert({copyVertex, vertex}).first->second != vertex)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    size_t attemptNum = 0;
+    for (size_t seed = 0; seed < faceNum; ++seed) {
+        for (size_t rotation = 0; rotation < 3; ++rotation) {
+            if (!matchLengths(representative[0], copy[seed], rotation))
+                continue;
+            if (grow((Index)seed, rotation)) {
+                std::vector<Index> reorderedCopy(faceNum);
+                for (size_t i = 0; i < faceNum; ++i)
+                    reorderedCopy[i] = copy[copyFaces[i]];
+                copy.swap(reorderedCopy);
+                cornerRotations.swap(rotations);
+                return true;
+            }
+            if (++attemptNum >= kMaxMatchAttemptNum)
+                return false;
+        }
+    }
+    return false;
+}
+
+}
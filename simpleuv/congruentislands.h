@@ -0,0 +1,23 @@
+#ifndef SIMPLEUV_CONGRUENT_ISLANDS_H
+#define SIMPLEUV_CONGRUENT_ISLANDS_H
+#include <vector>
+#include <cstdint>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+// Hash of the face count and the sorted edge lengths of the island, rounded to lengthQuantum.
+// Congruent islands get the same fingerprint, unless a length sits right on a rounding step
+uint64_t fingerprintIsland(const CompactMesh &mesh, const std::vector<Index> &island, float lengthQuantum);
+
+// Looks for a face correspondence between two islands that keeps the adjacency and matches every edge length
+// within lengthTolerance, starting from the faces that match the first face of the representative.
+// On success the faces of copy are reordered so copy[i] corresponds to representative[i], with corner j
+// of representative[i] being corner (j + cornerRotations[i]) % 3 of copy[i]. Mirrored copies don't match
+bool matchCongruentIsland(const CompactMesh &mesh, const std::vector<Index> &representative, std::vector<Index> &copy,
+    float lengthTolerance, std::vector<unsigned char> &cornerRotations);
+
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <Eigen/Geometry>
+#include <simpleuv/cotangentlaplacian.h>
+#include <simpleuv/parallelfor.h>
+#include <simpleuv/simd.h>
+
+namespace simpleuv
+{
+
+// Below this many faces the threads cost more than they save
+static const int kParallelMinFaceNum = 20000;
+static const int kBlockSize = 256;
+
+// weights[f * 3 + a] is half the cotangent of the angle at corner a, which goes to the edge opposite it
+template <class Scalar>
+static void calculateCotangentWeights(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &V, const Eigen::MatrixXi &F,
+    int begin, int end, Scalar *weights)
+{
+    for (int f = begin; f < end; ++f) {
+        Eigen::Matrix<Scalar, 3, 1> p0 = V.row(F(f, 0)).transpose();
+        Eigen::Matrix<Scalar, 3, 1> p1 = V.row(F(f, 1)).transpose();
+        Eigen::Matrix<Scalar, 3, 1> p2 = V.row(F(f, 2)).transpose();
+        Eigen::Matrix<Scalar, 3, 1> e0 = p2 - p1;
+        Eigen::Matrix<Scalar, 3, 1> e1 = p0 - p2;
+        Eigen::Matrix<Scalar, 3, 1> e2 = p1 - p0;
+        Scalar inverse = Scalar(-0.5) / e1.cross(e2).norm();
+        weights[f * 3] = e1.dot(e2) * inverse;
+        weights[f * 3 + 1] = e2.dot(e0) * inverse;
+        weights[f * 3 + 2] = e0.dot(e1) * inverse;
+    }
+}
+
+// The float weights are computed on full SIMD vectors, faces are gathered in blocks into SoA arrays of their corners
+static void calculateCotangentWeights(const Eigen::MatrixXf &V, const Eigen::MatrixXi &F,
+    int begin, int end, float *weights)
+{
+    float corners[9][kBlockSize];
+    float results[3][kBlockSize];
+    const simd::Float zero = simd::broadcast(0.0f);
+    const simd::Float minusHalf = simd::broadcast(-0.5f);
+    for (int blockBegin = begin; blockBegin < end; blockBegin += kBlockSize) {
+        int count = std::min(kBlockSize, end - blockBegin);
+        int paddedCount = (count + simd::kWidth - 1) / simd::kWidth * simd::kWidth;
+        for (int i = 0; i < count; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                int v = F(blockBegin + i, j);
+                for (int k = 0; k < 3; ++k)
+                    corners[j * 3 + k][i] = V(v, k);
+            }
+        }
+        // Padding lanes get a unit right triangle so they stay finite
+        for (int i = count; i < paddedCount; ++i) {
+            for (int k = 0; k < 9; ++k)
+                corners[k][i] = 0;
+            corners[3][i] = 1;
+            corners[7][i] = 1;
+        }
+        for (int i = 0; i < paddedCount; i += simd::kWidth) {
+            simd::Float e0[3], e1[3], e2[3];
+            for (int k = 0; k < 3; ++k) {
+                simd::Float p0 = simd::load(&corners[k][i]);
+                simd::Float p1 = simd::load(&corners[3 + k][i]);
+                simd::Float p2 = simd::load(&corners[6 + k][i]);
+                e0[k] = p2 - p1;
+                e1[k] = p0 - p2;
+                e2[k] = p1 - p0;
+            }
+            simd::Float nx = e1[1] * e2[2] - e1[2] * e2[1];
+            simd::Float ny = e1[2] * e2[0] - e1[0] * e2[2];
+            simd::Float nz = e1[0] * e2[1] - e1[1] * e2[0];
+            simd::Float doubleArea = simd::sqrt(simd::mulAdd(nx, nx, simd::mulAdd(ny, ny, nz * nz)));
+            simd::Float inverse = minusHalf / doubleArea;
+            simd::Float dot0 = zero, dot1 = zero, dot2 = zero;
+            for (int k = 0; k < 3; ++k) {
+                dot0 = simd::mulAdd(e1[k], e2[k], dot0);
+                dot1 = simd::mulAdd(e2[k], e0[k], dot1);
+                dot2 = simd::mulAdd(e0[k], e1[k], dot2);
+            }
+            simd::store(&results[0][i], dot0 * inverse);
+            simd::store(&results[1][i], dot1 * inverse);
+            simd::store(&results[2][i], dot2 * inverse);
+        }
+        for (int i = 0; i < count; ++i) {
+            for (int a = 0; a < 3; ++a)
+                weights[(blockBegin + i) * 3 + a] = results[a][i];
+        }
+    }
+}
+
+void CotangentLaplacian::setThreadNum(size_t threadNum)
+{
+    m_threadNum = threadNum;
+}
+
+void CotangentLaplacian::buildPattern(int vertexNum, const Eigen::MatrixXi &F)
+{
+    m_vertexNum = vertexNum;
+    m_faces = F;
+    int faceNum = F.rows();
+    size_t threadNum = faceNum < kParallelMinFaceNum ? 1 : m_threadNum;
+
+    m_incidenceOffsets.assign(vertexNum + 1, 0);
+    for (int f = 0; f < faceNum; ++f) {
+        for (int a = 0; a < 3; ++a)
+            ++m_incidenceOffsets[F(f, a) + 1];
+    }
+    for (int v = 0; v < vertexNum; ++v)
+        m_incidenceOffsets[v + 1] += m_incidenceOffsets[v];
+    m_incidences.resize(faceNum * 3);
+    std::vector<int> ends(m_incidenceOffsets.begin(), m_incidenceOffsets.end() - 1);
+    for (int f = 0; f < faceNum; ++f) {
+        for (int a = 0; a < 3; ++a)
+            m_incidences[ends[F(f, a)]++] = f * 3 + a;
+    }
+
+    // Each column is the vertex and its neighbors, sorted, first into room for the worst case then packed
+    std::vector<int> scratch(faceNum * 6 + vertexNum);
+    std::vector<int> columnSizes(vertexNum);
+    parallelFor(vertexNum, threadNum, [&](size_t vertexBegin, size_t vertexEnd) {
+        for (int v = (int)vertexBegin; v < (int)vertexEnd; ++v) {
+            int *column = scratch.data() + m_incidenceOffsets[v] * 2 + v;
+            int size = 0;
+            column[size++] = v;
+            for (int k = m_incidenceOffsets[v]; k < m_incidenceOffsets[v + 1]; ++k) {
+                int f = m_incidences[k] / 3;
+                int a = m_incidences[k] % 3;
+                column[size++] = F(f, (a + 1) % 3);
+                column[size++] = F(f, (a + 2) % 3);
+            }
+            std::sort(column, column + size);
+            columnSizes[v] = std::unique(column, column + size) - column;
+        }
+    });
+    m_outerIndices.resize(vertexNum + 1);
+    m_outerIndices[0] = 0;
+    for (int v = 0; v < vertexNum; ++v)
+        m_outerIndices[v + 1] = m_outerIndices[v] + columnSizes[v];
+    m_innerIndices.resize(m_outerIndices[vertexNum]);
+    m_diagonalSlots.resize(vertexNum);
+    m_incidenceSlots.resize(faceNum * 6);
+    parallelFor(vertexNum, threadNum, [&](size_t vertexBegin, size_t vertexEnd) {
+        for (int v = (int)vertexBegin; v < (int)vertexEnd; ++v) {
+            const int *column = scratch.data() + m_incidenceOffsets[v] * 2 + v;
+            int *inner = m_innerIndices.data() + m_outerIndices[v];
+            std::copy(column, column + columnSizes[v], inner);
+            auto slotOf = [&](int row) {
+                return m_outerIndices[v] + (int)(std::lower_bound(inner, inner + columnSizes[v], row) - inner);
+            };
+            m_diagonalSlots[v] = slotOf(v);
+            for (int k = m_incidenceOffsets[v]; k < m_incidenceOffsets[v + 1]; ++k) {
+                int f = m_incidences[k] / 3;
+                int a = m_incidences[k] % 3;
+                m_incidenceSlots[k * 2] = slotOf(F(f, (a + 1) % 3));
+                m_incidenceSlots[k * 2 + 1] = slotOf(F(f, (a + 2) % 3));
+            }
+        }
+    });
+}
+
+template <class Scalar>
+void CotangentLaplacian::assemble(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &V, const Eigen::MatrixXi &F,
+    Eigen::SparseMatrix<Scalar> &L)
+{
+    int vertexNum = V.rows();
+    int faceNum = F.rows();
+    if (vertexNum != m_vertexNum || F.rows() != m_faces.rows() || F != m_faces)
+        buildPattern(vertexNum, F);
+    size_t threadNum = faceNum < kParallelMinFaceNum ? 1 : m_threadNum;
+
+    std::vector<Scalar> weights(faceNum * 3);
+    int blockNum = (faceNum + kBlockSize - 1) / kBlockSize;
+    parallelFor(blockNum, threadNum, [&](size_t blockBegin, size_t blockEnd) {
+        int begin = (int)blockBegin * kBlockSize;
+        int end = std::min(faceNum, (int)blockEnd * kBlockSize);
+        if (begin < end)
+            calculateCotangentWeights(V, F, begin, end, weights.data());
+    });
+
+    L.resize(vertexNum, vertexNum);
+    L.resizeNonZeros(m_innerIndices.size());
+    std::copy(m_outerIndices.begin(), m_outerIndices.end(), L.outerIndexPtr());
+    std::copy(m_innerIndices.begin(), m_innerIndices.end(), L.innerIndexPtr());
+    Scalar *values = L.valuePtr();
+    parallelFor(vertexNum, threadNum, [&](size_t vertexBegin, size_t vertexEnd) {
+        for (int v = (int)vertexBegin; v < (int)vertexEnd; ++v) {
+            std::fill(values + m_outerIndices[v], values + m_outerIndices[v + 1], Scalar(0));
+            Scalar diagonal = 0;
+            for (int k = m_incidenceOffsets[v]; k < m_incidenceOffsets[v + 1]; ++k) {
+                int f = m_incidences[k] / 3;
+                int a = m_incidences[k] % 3;
+                // The edge to the next corner is opposite the previous corner and the other way around
+                Scalar nextWeight = weights[f * 3 + (a + 2) % 3];
+                Scalar previousWeight = weights[f * 3 + (a + 1) % 3];
+                values[m_incidenceSlots[k * 2]] += nextWeight;
+                values[m_incidenceSlots[k * 2 + 1]] += previousWeight;
+                diagonal -= nextWeight + previousWeight;
+            }
+            values[m_diagonalSlots[v]] += diagonal;
+        }
+    });
+}
+
+template void CotangentLaplacian::assemble<float>(const Eigen::MatrixXf &V, const Eigen::MatrixXi &F,
+    Eigen::SparseMatrix<float> &L);
+template void CotangentLaplacian::assemble<double>(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+    Eigen::SparseMatrix<double> &L);
+
+}
@@ -0,0 +1,39 @@
+#ifndef SIMPLEUV_COTANGENT_LAPLACIAN_H
+#define SIMPLEUV_COTANGENT_LAPLACIAN_H
+#include <vector>
+#include <cstdlib>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+
+namespace simpleuv
+{
+
+// The same matrix as igl::cotmatrix for triangles, negative semidefinite with half the cotangents off the diagonal.
+// The compressed column pattern comes straight from the vertex to face incidences instead of a triplet sort,
+// and every incidence knows the two value slots it adds to, so a column is summed by one thread without atomics.
+// The pattern is kept and reused for as long as the faces stay the same
+class CotangentLaplacian
+{
+public:
+    // 0 means one thread per hardware thread, small meshes stay on the calling thread either way
+    void setThreadNum(size_t threadNum);
+    template <class Scalar>
+    void assemble(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &V, const Eigen::MatrixXi &F,
+        Eigen::SparseMatrix<Scalar> &L);
+private:
+    void buildPattern(int vertexNum, const Eigen::MatrixXi &F);
+    size_t m_threadNum = 0;
+    int m_vertexNum = -1;
+    Eigen::MatrixXi m_faces;
+    std::vector<int> m_outerIndices;
+    std::vector<int> m_innerIndices;
+    std::vector<int> m_diagonalSlots;
+    // The face corners around each vertex, face * 3 + corner, and for each the slots of the next and the previous corner
+    std::vector<int> m_incidenceOffsets;
+    std::vector<int> m_incidences;
+    std::vector<int> m_incidenceSlots;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <simpleuv/facenormals.h>
+#include <simpleuv/simd.h>
+
+namespace simpleuv
+{
+
+// Faces are processed in blocks, the corner positions of each block are gathered into SoA arrays first,
+// so the cross product and normalization run on full vectors
+static const size_t kBlockSize = 256;
+
+template <class FaceType>
+static void calculateFaceNormalsImpl(const std::vector<Vertex> &vertices, const std::vector<FaceType> &faces,
+    std::vector<Vector3> &faceNormals)
+{
+    faceNormals.resize(faces.size());
+    
+    float corners[9][kBlockSize];
+    float normals[3][kBlockSize];
+    const simd::Float zero = simd::broadcast(0.0f);
+    const simd::Float one = simd::broadcast(1.0f);
+    for (size_t begin = 0; begin < faces.size(); begin += kBlockSize) {
+        size_t count = std::min(kBlockSize, faces.size() - begin);
+        size_t paddedCount = (count + simd::kWidth - 1) / simd::kWidth * simd::kWidth;
+        for (size_t i = 0; i < count; ++i) {
+            const auto &face = faces[begin + i];
+            for (size_t j = 0; j < 3; ++j) {
+                const auto &vertex = vertices[face.indices[j]];
+                corners[j * 3 + 0][i] = vertex.xyz[0];
+                corners[j * 3 + 1][i] = vertex.xyz[1];
+                corners[j * 3 + 2][i] = vertex.xyz[2];
+            }
+        }
+        for (size_t i = count; i < paddedCount; ++i) {
+            for (size_t j = 0; j < 9; ++j)
+                corners[j][i] = 0;
+        }
+        for (size_t i = 0; i < paddedCount; i += simd::kWidth) {
+            simd::Float ax = simd::load(&corners[0][i]);
+            simd::Float ay = simd::load(&corners[1][i]);
+            simd::Float az = simd::load(&corners[2][i]);
+            simd::Float ux = simd::load(&corners[3][i]) - ax;
+            simd::Float uy = simd::load(&corners[4][i]) - ay;
+            simd::Float uz = simd::load(&corners[5][i]) - az;
+            simd::Float vx = simd::load(&corners[6][i]) - ax;
+            simd::Float vy = simd::load(&corners[7][i]) - ay;
+            simd::Float vz = simd::load(&corners[8][i]) - az;
+            simd::Float nx = uy * vz - uz * vy;
+            simd::Float ny = uz * vx - ux * vz;
+            simd::Float nz = ux * vy - uy * vx;
+            simd::Float length = simd::sqrt(simd::mulAdd(nx, nx, simd::mulAdd(ny, ny, nz * nz)));
+            // Degenerated faces get zero normal
+            simd::Float inverseLength = simd::select(simd::lessThan(zero, length), one / length, zero);
+            simd::store(&normals[0][i], nx * inverseLength);
+            simd::store(&normals[1][i], ny * inverseLength);
+            simd::store(&normals[2][i], nz * inverseLength);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            auto &normal = faceNormals[begin + i];
+            normal.xyz[0] = normals[0][i];
+            normal.xyz[1] = normals[1][i];
+            normal.xyz[2] = normals[2][i];
+        }
+    }
+}
+
+void calculateFaceNormals(const std::vector<Vertex> &vertices, const std::vector<Face> &faces,
+    std::vector<Vector3> &faceNormals)
+{
+    calculateFaceNormalsImpl(vertices, faces, faceNormals);
+}
+
+void calculateFaceNormals(const std::vector<Vertex> &vertices, const std::vector<CompactFace> &faces,
+    std::vector<Vector3> &faceNormals)
+{
+    calculateFaceNormalsImpl(vertices, faces, faceNormals);
+}
+
+void testAdjacentFaceNormals(const std::vector<Vector3> &faceNormals, const Index *faces,
+    const std::vector<Index> &oppositeFaces, float threshold, std::vector<unsigned char> &passedEdges)
+{
+    size_t edgeNum = oppositeFaces.size();
+    passedEdges.resize(edgeNum);
+    
+    float pairs[6][kBlockSize];
+    const simd::Float limit = simd::broadcast(threshold);
+    for (size_t begin = 0; begin < edgeNum; begin += kBlockSize) {
+        size_t count = std::min(kBlockSize, edgeNum - begin);
+        size_t paddedCount = (count + simd::kWidth - 1) / simd::kWidth * simd::kWidth;
+        for (size_t i = 0; i < count; ++i) {
+            size_t edge = begin + i;
+            Index opposite = oppositeFaces[edge];
+            const auto &first = faceNormals[faces[edge / 3]];
+            const auto &second = faceNormals[faces[(Index)-1 == opposite ? edge / 3 : opposite]];
+            for (size_t k = 0; k < 3; ++k) {
+                pairs[k][i] = first.xyz[k];
+                pairs[3 + k][i] = second.xyz[k];
+            }
+        }
+        for (size_t i = count; i < paddedCount; ++i) {
+            for (size_t k = 0; k < 6; ++k)
+                pairs[k][i] = 0;
+        }
+        for (size_t i = 0; i < paddedCount; i += simd::kWidth) {
+            simd::Float dot = simd::mulAdd(simd::load(&pairs[0][i]), simd::load(&pairs[3][i]),
+                simd::mulAdd(simd::load(&pairs[1][i]), simd::load(&pairs[4][i]),
+                    simd::load(&pairs[2][i]) * simd::load(&pairs[5][i])));
+            int passed = simd::bits(simd::greaterEqual(dot, limit));
+            size_t laneNum = std::min((size_t)simd::kWidth, count - i);
+            for (size_t lane = 0; lane < laneNum; ++lane)
+                passedEdges[begin + i + lane] = (passed >> lane) & 1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if ((Index)-1 == oppositeFaces[begin + i])
+                passedEdges[begin + i] = 0;
+        }
+    }
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef SIMPLEUV_FACE_NORMALS_H
+#define SIMPLEUV_FACE_NORMALS_H
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+void calculateFaceNormals(const std::vector<Vertex> &vertices, const std::vector<Face> &faces,
+    std::vector<Vector3> &faceNormals);
+void calculateFaceNormals(const std::vector<Vertex> &vertices, const std::vector<CompactFace> &faces,
+    std::vector<Vector3> &faceNormals);
+
+// passedEdges[i * 3 + j] is set when the normal of faces[i] and the normal of its neighbor
+// oppositeFaces[i * 3 + j] (index into faces, (Index)-1 means border) have dot product not less than threshold
+void testAdjacentFaceNormals(const std::vector<Vector3> &faceNormals, const Index *faces,
+    const std::vector<Index> &oppositeFaces, float threshold, std::vector<unsigned char> &passedEdges);
+
+}
+
+#endif
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <cmath>
+#include <queue>
+#include <simpleuv/graphpartitioner.h>
+
+namespace simpleuv
+{
+
+struct WeightedGraph
+{
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+    std::vector<int> edgeWeights;
+    std::vector<int> vertexWeights;
+    int vertexNum() const
+    {
+        return (int)vertexWeights.size();
+    }
+};
+
+static const int kCoarsestVertexNum = 100;
+static const int kSeedNum = 4;
+static const int kRefinePassNum = 4;
+// A refinement pass gives up after this many moves without finding a better cut
+static const int kMaxFruitlessMoveNum = 64;
+// How much heavier than its target a side of a bisection may get
+static const double kImbalance = 0.03;
+
+// coarseVertices[v] is the vertex of coarse that v was merged into
+static void coarsen(const WeightedGraph &graph, WeightedGraph &coarse, std::vector<int> &coarseVertices)
+{
+    int vertexNum = graph.vertexNum();
+    // Low degree vertices go first, they have the fewest neighbors left to match with
+    std::vector<int> order(vertexNum);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return graph.offsets[a + 1] - graph.offsets[a] < graph.offsets[b + 1] - graph.offsets[b];
+    });
+    coarseVertices.assign(vertexNum, -1);
+    std::vector<int> members;
+    members.reserve(vertexNum * 2);
+    int coarseNum = 0;
+    for (int v: order) {
+        if (-1 != coarseVertices[v])
+            continue;
+        int partner = -1;
+        int partnerWeight = 0;
+        for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+            int neighbor = graph.neighbors[k];
+            if (-1 != coarseVertices[neighbor] || neighbor == v)
+                continue;
+            if (graph.edgeWeights[k] > partnerWeight) {
+                partner = neighbor;
+                partnerWeight = graph.edgeWeights[k];
+            }
+        }
+        coarseVertices[v] = coarseNum;
+        members.push_back(v);
+        if (-1 != partner)
+            coarseVertices[partner] = coarseNum;
+        members.push_back(partner);
+        ++coarseNum;
+    }
+
+    // The edges of the matched pair are merged, slots[c] is where coarse vertex c is in the list being built
+    coarse.offsets.assign(coarseNum + 1, 0);
+    coarse.vertexWeights.assign(coarseNum, 0);
+    coarse.neighbors.clear();
+    coarse.edgeWeights.clear();
+    coarse.neighbors.reserve(graph.neighbors.size());
+    coarse.edgeWeights.reserve(graph.neighbors.size());
+    std::vector<int> slots(coarseNum, -1);
+    for (int c = 0; c < coarseNum; ++c) {
+        int begin = coarse.neighbors.size();
+        for (int i = 0; i < 2; ++i) {
+            int member = members[c * 2 + i];
+            if (-1 == member)
+                continue;
+            coarse.vertexWeights[c] += graph.vertexWeights[member];
+            for (int k = graph.offsets[member]; k < graph.offsets[member + 1]; ++k) {
+                int target = coarseVertices[graph.neighbors[k]];
+                if (target == c)
+                    continue;
+                int slot = slots[target];
+                if (slot >= begin && coarse.neighbors[slot] == target) {
+                    coarse.edgeWeights[slot] += graph.edgeWeights[k];
+                    continue;
+                }
+                slots[target] = coarse.neighbors.size();
+                coarse.neighbors.push_back(target);
+                coarse.edgeWeights.push_back(graph.edgeWeights[k]);
+            }
+        }
+        coarse.offsets[c + 1] = coarse.neighbors.size();
+    }
+}
+
+static int calculateCut(const WeightedGraph &graph, const std::vector<char> &sides)
+{
+    int cut = 0;
+    for (int v = 0; v < graph.vertexNum(); ++v) {
+        for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+            if (sides[graph.neighbors[k]] != sides[v])
+                cut += graph.edgeWeights[k];
+        }
+    }
+    return cut / 2;
+}
+
+static int calculateGain(const WeightedGraph &graph, const std::vector<char> &sides, int v)
+{
+    int gain = 0;
+    for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k)
+        gain += sides[graph.neighbors[k]] == sides[v] ? -graph.edgeWeights[k] : graph.edgeWeights[k];
+    return gain;
+}
+
+// A side over its maximum first gives up boundary vertices, the ones cutting the most edges first,
+// then Fiduccia-Mattheyses passes move the vertex with the best gain one at a time, through worse cuts too,
+// and roll back to the best cut seen. Every move keeps the other side within its maximum weight
+static void refineBisection(const WeightedGraph &graph, const int targetWeights[2], const int maxWeights[2],
+    std::vector<char> &sides, int sideWeights[2])
+{
+    int vertexNum = graph.vertexNum();
+    std::vector<int> gains(vertexNum);
+    std::vector<char> locked(vertexNum);
+    std::vector<int> moves;
+    std::priority_queue<std::pair<int, int>> candidates;
+    auto isBoundary = [&](int v) {
+        for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+            if (sides[graph.neighbors[k]] != sides[v])
+                return true;
+        }
+        return false;
+    };
+    auto imbalanceOf = [&]() {
+        return std::abs(sideWeights[0] - targetWeights[0]);
+    };
+    for (int pass = 0; pass < kRefinePassNum; ++pass) {
+        candidates = std::priority_queue<std::pair<int, int>>();
+        for (int v = 0; v < vertexNum; ++v) {
+            gains[v] = calculateGain(graph, sides, v);
+            locked[v] = 0;
+            if (isBoundary(v))
+                candidates.push(std::make_pair(gains[v], v));
+        }
+        moves.clear();
+        int cutChange = 0;
+        int bestCutChange = 0;
+        int bestImbalance = imbalanceOf();
+        bool bestOverweight = sideWeights[0] > maxWeights[0] || sideWeights[1] > maxWeights[1];
+        size_t bestMoveNum = 0;
+        while (!candidates.empty() && moves.size() < bestMoveNum + kMaxFruitlessMoveNum) {
+            int gain = candidates.top().first;
+            int v = candidates.top().second;
+            candidates.pop();
+            if (locked[v] || gain != gains[v])
+                continue;
+            int from = sides[v];
+            int to = 1 - from;
+            int weight = graph.vertexWeights[v];
+            bool overweight = sideWeights[0] > maxWeights[0] || sideWeights[1] > maxWeights[1];
+            if (sideWeights[to] + weight > maxWeights[to] || (overweight && sideWeights[from] <= maxWeights[from])) {
+                locked[v] = 1;
+                continue;
+            }
+            locked[v] = 1;
+            sides[v] = to;
+            sideWeights[from] -= weight;
+            sideWeights[to] += weight;
+            cutChange -= gain;
+            moves.push_back(v);
+            for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+                int neighbor = graph.neighbors[k];
+                if (locked[neighbor])
+                    continue;
+                gains[neighbor] += sides[neighbor] == to ? -2 * graph.edgeWeights[k] : 2 * graph.edgeWeights[k];
+                candidates.push(std::make_pair(gains[neighbor], neighbor));
+            }
+            bool nowOverweight = sideWeights[0] > maxWeights[0] || sideWeights[1] > maxWeights[1];
+            int imbalance = imbalanceOf();
+            if ((bestOverweight && !nowOverweight) || (!nowOverweight && (cutChange < bestCutChange ||
+                    (cutChange == bestCutChange && imbalance < bestImbalance)))) {
+                bestOverweight = nowOverweight;
+                bestCutChange = cutChange;
+                bestImbalance = imbalance;
+                bestMoveNum = moves.size();
+            }
+        }
+        while (moves.size() > bestMoveNum) {
+            int v = moves.back();
+            moves.pop_back();
+            int from = sides[v];
+            sides[v] = 1 - from;
+            sideWeights[from] -= graph.vertexWeights[v];
+            sideWeights[1 - from] += graph.vertexWeights[v];
+        }
+        if (0 == bestMoveNum)
+            break;
+    }
+}
+
+// Grows side 0 breadth first from a few seeds and keeps the one that cuts the fewest edges after refinement
+static void growBisection(const WeightedGraph &graph, const int targetWeights[2], const int maxWeights[2],
+    std::vector<char> &sides)
+{
+    int vertexNum = graph.vertexNum();
+    int bestCut = -1;
+    std::vector<char> trialSides;
+    std::queue<int> waitVertices;
+    for (int seedIndex = 0; seedIndex < std::min(kSeedNum, vertexNum); ++seedIndex) {
+        int seed = (int)((long long)seedIndex * vertexNum / std::min(kSeedNum, vertexNum));
+        trialSides.assign(vertexNum, 1);
+        int sideWeights[2] = {0, 0};
+        for (int v = 0; v < vertexNum; ++v)
+            sideWeights[1] += graph.vertexWeights[v];
+        int nextSeed = 0;
+        waitVertices = std::queue<int>();
+        waitVertices.push(seed);
+        trialSides[seed] = 0;
+        while (sideWeights[0] < targetWeights[0]) {
+            if (waitVertices.empty()) {
+                // The graph can be disconnected, carry on from another component
+                while (nextSeed < vertexNum && 0 == trialSides[nextSeed])
+                    ++nextSeed;
+                if (nextSeed >= vertexNum)
+                    break;
+                trialSides[nextSeed] = 0;
+                waitVertices.push(nextSeed);
+            }
+            int v = waitVertices.front();
+            waitVertices.pop();
+            sideWeights[0] += graph.vertexWeights[v];
+            sideWeights[1] -= graph.vertexWeights[v];
+            for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+                int neighbor = graph.neighbors[k];
+                if (0 == trialSides[neighbor])
+                    continue;
+                trialSides[neighbor] = 0;
+                waitVertices.push(neighbor);
+            }
+        }
+        // The queued vertices were marked when found, only the popped ones are on side 0
+        while (!waitVertices.empty()) {
+            trialSides[waitVertices.front()] = 1;
+            waitVertices.pop();
+        }
+        refineBisection(graph, targetWeights, maxWeights, trialSides, sideWeights);
+        int cut = calculateCut(graph, trialSides);
+        if (-1 == bestCut || cut < bestCut) {
+            bestCut = cut;
+            sides = trialSides;
+        }
+    }
+}
+
+// Side 0 gets about ratio of the vertex weight, neither side gets more than maxSideWeights if that can be helped
+static void bisect(const WeightedGraph &graph, double ratio, const int maxSideWeights[2], std::vector<char> &sides)
+{
+    std::vector<std::unique_ptr<WeightedGraph>> levels;
+    std::vector<std::vector<int>> coarseVertices;
+    const WeightedGraph *current = &graph;
+    while (current->vertexNum() > kCoarsestVertexNum) {
+        std::unique_ptr<WeightedGraph> coarse(new WeightedGraph);
+        std::vector<int> map;
+        coarsen(*current, *coarse, map);
+        // Stop once matching hardly shrinks the graph any more, like on stars
+        if (coarse->vertexNum() > current->vertexNum() * 0.9)
+            break;
+        levels.push_back(std::move(coarse));
+        coarseVertices.push_back(std::move(map));
+        current = levels.back().get();
+    }
+
+    int totalWeight = std::accumulate(graph.vertexWeights.begin(), graph.vertexWeights.end(), 0);
+    int targetWeights[2];
+    targetWeights[0] = std::max(1, (int)std::lround(totalWeight * ratio));
+    targetWeights[1] = totalWeight - targetWeights[0];
+    int maxWeights[2] = {
+        std::min(maxSideWeights[0], (int)std::ceil(targetWeights[0] * (1 + kImbalance))),
+        std::min(maxSideWeights[1], (int)std::ceil(targetWeights[1] * (1 + kImbalance)))
+    };
+
+    std::vector<char> levelSides;
+    growBisection(*current, targetWeights, maxWeights, levelSides);
+    for (int level = (int)levels.size() - 1; level >= 0; --level) {
+        const WeightedGraph &finer = level > 0 ? *levels[level - 1] : graph;
+        const std::vector<int> &map = coarseVertices[level];
+        std::vector<char> finerSides(finer.vertexNum());
+        int sideWeights[2] = {0, 0};
+        for (int v = 0; v < finer.vertexNum(); ++v) {
+            finerSides[v] = levelSides[map[v]];
+            sideWeights[(int)finerSides[v]] += finer.vertexWeights[v];
+        }
+        refineBisection(finer, targetWeights, maxWeights, finerSides, sideWeights);
+        levelSides.swap(finerSides);
+    }
+    sides.swap(levelSides);
+}
+
+static void extractSubgraph(const WeightedGraph &graph, const std::vector<int> &vertices, const std::vector<char> &sides,
+    char side, std::vector<int> &localIndices, WeightedGraph &subgraph, std::vector<int> &subVertices)
+{
+    subVertices.clear();
+    for (int v = 0; v < graph.vertexNum(); ++v) {
+        if (sides[v] != side)
+            continue;
+        localIndices[v] = subVertices.size();
+        subVertices.push_back(v);
+    }
+    subgraph.offsets.assign(subVertices.size() + 1, 0);
+    subgraph.vertexWeights.resize(subVertices.size());
+    subgraph.neighbors.clear();
+    subgraph.edgeWeights.clear();
+    for (size_t i = 0; i < subVertices.size(); ++i) {
+        int v = subVertices[i];
+        subgraph.vertexWeights[i] = graph.vertexWeights[v];
+        for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+            int neighbor = graph.neighbors[k];
+            if (sides[neighbor] != side)
+                continue;
+            subgraph.neighbors.push_back(localIndices[neighbor]);
+            subgraph.edgeWeights.push_back(graph.edgeWeights[k]);
+        }
+        subgraph.offsets[i + 1] = subgraph.neighbors.size();
+        // Back to the caller's numbering
+        subVertices[i] = vertices[v];
+    }
+}
+
+// The graph goes into partNumToMake parts, the part count is decided once up front so the slack for balance
+// doesn't add up level after level
+static void partitionRecursively(const WeightedGraph &graph, const std::vector<int> &vertices, int maxPartSize,
+    int partNumToMake, int &partNum, std::vector<int> &parts)
+{
+    int vertexNum = graph.vertexNum();
+    if (vertexNum <= maxPartSize) {
+        for (int v: vertices)
+            parts[v] = partNum;
+        ++partNum;
+        return;
+    }
+    // Only when a bisection couldn't meet the maximum weights
+    partNumToMake = std::max(partNumToMake, std::max(2, (vertexNum + maxPartSize - 1) / maxPartSize));
+    int firstPartNum = partNumToMake / 2;
+    int maxSideWeights[2] = {firstPartNum * maxPartSize, (partNumToMake - firstPartNum) * maxPartSize};
+    std::vector<char> sides;
+    bisect(graph, (double)firstPartNum / partNumToMake, maxSideWeights, sides);
+    int sideSizes[2] = {0, 0};
+    for (int v = 0; v < vertexNum; ++v)
+        ++sideSizes[(int)sides[v]];
+    if (0 == sideSizes[0] || 0 == sideSizes[1]) {
+        for (int v = 0; v < vertexNum; ++v)
+            sides[v] = v < vertexNum / 2 ? 0 : 1;
+    }
+    std::vector<int> localIndices(vertexNum);
+    int sidePartNums[2] = {firstPartNum, partNumToMake - firstPartNum};
+    for (char side = 0; side < 2; ++side) {
+        WeightedGraph subgraph;
+        std::vector<int> subVertices;
+        extractSubgraph(graph, vertices, sides, side, localIndices, subgraph, subVertices);
+        partitionRecursively(subgraph, subVertices, maxPartSize, sidePartNums[(int)side], partNum, parts);
+    }
+}
+
+int partitionGraph(const std::vector<int> &offsets, const std::vector<int> &neighbors, int maxPartSize,
+    std::vector<int> &parts)
+{
+    int vertexNum = (int)offsets.size() - 1;
+    parts.assign(std::max(vertexNum, 0), 0);
+    if (vertexNum <= 0)
+        return 0;
+    WeightedGraph graph;
+    graph.offsets = offsets;
+    graph.neighbors = neighbors;
+    graph.edgeWeights.assign(neighbors.size(), 1);
+    graph.vertexWeights.assign(vertexNum, 1);
+    std::vector<int> vertices(vertexNum);
+    std::iota(vertices.begin(), vertices.end(), 0);
+    maxPartSize = std::max(maxPartSize, 1);
+    // A little more than the fewest parts, so the refinement has room to trade balance for a shorter cut
+    int partNumToMake = (int)std::ceil(vertexNum * (1 + kImbalance) / maxPartSize);
+    int partNum = 0;
+    partitionRecursively(graph, vertices, maxPartSize, partNumToMake, partNum, parts);
+    return partNum;
+}
+
+}
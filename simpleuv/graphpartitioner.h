@@ -0,0 +1,18 @@
+#ifndef SIMPLEUV_GRAPH_PARTITIONER_H
+#define SIMPLEUV_GRAPH_PARTITIONER_H
+#include <vector>
+
+namespace simpleuv
+{
+
+// The graph is undirected with unit weights, the neighbors of vertex v are neighbors[offsets[v], offsets[v + 1]).
+// Splits it into parts of at most maxPartSize vertices, balanced and with few edges between them, by recursive
+// bisection. Every bisection is multilevel: the graph is coarsened by heavy edge matching, the coarsest graph is
+// bisected by greedy growing from a few seeds, and the cut is refined at every level on the way back.
+// parts[v] receives the part of v, returns the part count. A part is not guaranteed to be connected
+int partitionGraph(const std::vector<int> &offsets, const std::vector<int> &neighbors, int maxPartSize,
+    std::vector<int> &parts);
+
+}
+
+#endif
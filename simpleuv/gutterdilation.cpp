@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <simpleuv/gutterdilation.h>
+#include <simpleuv/uvrasterizer.h>
+#include <simpleuv/simd.h>
+#include <simpleuv/parallelfor.h>
+
+namespace simpleuv
+{
+
+static bool isCovered(const uint64_t *coverageRow, int x)
+{
+    return 0 != (coverageRow[x >> 6] & ((uint64_t)1 << (x & 63)));
+}
+
+// Sums the element with its left and right texel neighbors, the padded rows have one zero texel on each side
+static void sumHorizontalNeighbors(const float *paddedRow, int elementNum, int channelNum, float *sums)
+{
+    int i = 0;
+    for (; i + simd::kWidth <= elementNum; i += simd::kWidth) {
+        simd::Float sum = simd::load(paddedRow + i) + simd::load(paddedRow + i + channelNum) +
+            simd::load(paddedRow + i + channelNum * 2);
+        simd::store(sums + i, sum);
+    }
+    for (; i < elementNum; ++i)
+        sums[i] = paddedRow[i] + paddedRow[i + channelNum] + paddedRow[i + channelNum * 2];
+}
+
+void dilateGutter(float *image, int width, int height, int channelNum,
+    std::vector<uint64_t> &coverage, int coverageWordNum, int passNum, size_t threadNum)
+{
+    if (width <= 0 || height <= 0 || channelNum <= 0 || passNum <= 0)
+        return;
+    int elementNum = width * channelNum;
+    int paddedElementNum = elementNum + channelNum * 2;
+    // Per element so the SIMD lanes line up with the interleaved channels: the covered values and
+    // the coverage weights, both padded, then their horizontal 3 tap sums
+    std::vector<float> weightedValues((size_t)paddedElementNum * height);
+    std::vector<float> weights((size_t)paddedElementNum * height);
+    std::vector<float> valueSums((size_t)elementNum * height);
+    std::vector<float> weightSums((size_t)elementNum * height);
+    std::vector<uint64_t> newCoverage;
+    for (int pass = 0; pass < passNum; ++pass) {
+        parallelFor(height, threadNum, [&](size_t rowBegin, size_t rowEnd) {
+            for (int y = (int)rowBegin; y < (int)rowEnd; ++y) {
+                const uint64_t *coverageRow = coverage.data() + (size_t)y * coverageWordNum;
+                const float *imageRow = image + (size_t)y * elementNum;
+                float *weightedRow = weightedValues.data() + (size_t)y * paddedElementNum;
+                float *weightRow = weights.data() + (size_t)y * paddedElementNum;
+                std::fill(weightedRow, weightedRow + channelNum, 0.0f);
+                std::fill(weightRow, weightRow + channelNum, 0.0f);
+                std::fill(weightedRow + channelNum + elementNum, weightedRow + paddedElementNum, 0.0f);
+                std::fill(weightRow + channelNum + elementNum, weightRow + paddedElementNum, 0.0f);
+                for (int x = 0; x < width; ++x) {
+                    float weight = isCovered(coverageRow, x) ? 1.0f : 0.0f;
+                    for (int c = 0; c < channelNum; ++c) {
+                        weightRow[channelNum + x * channelNum + c] = weight;
+                        weightedRow[channelNum + x * channelNum + c] = weight * imageRow[x * channelNum + c];
+                    }
+                }
+                sumHorizontalNeighbors(weightedRow, elementNum, channelNum, valueSums.data() + (size_t)y * elementNum);
+                sumHorizontalNeighbors(weightRow, elementNum, channelNum, weightSums.data() + (size_t)y * elementNum);
+            }
+        });
+        newCoverage = coverage;
+        parallelFor(height, threadNum, [&](size_t rowBegin, size_t rowEnd) {
+            for (int y = (int)rowBegin; y < (int)rowEnd; ++y) {
+                // Nothing to fill when the row is fully covered
+                const uint64_t *coverageRow = coverage.data() + (size_t)y * coverageWordNum;
+                bool rowFull = true;
+                for (int x = 0; x < width && rowFull; x += 64) {
+                    int bitNum = std::min(64, width - x);
+                    uint64_t fullWord = 64 == bitNum ? ~(uint64_t)0 : (((uint64_t)1 << bitNum) - 1);
+                    rowFull = (coverageRow[x >> 6] & fullWord) == fullWord;
+                }
+                if (rowFull)
+                    continue;
+                const float *rowValueSums[3];
+                const float *rowWeightSums[3];
+                size_t rowNum = 0;
+                for (int neighbor = std::max(0, y - 1); neighbor <= std::min(height - 1, y + 1); ++neighbor) {
+                    rowValueSums[rowNum] = valueSums.data() + (size_t)neighbor * elementNum;
+                    rowWeightSums[rowNum] = weightSums.data() + (size_t)neighbor * elementNum;
+                    ++rowNum;
+                }
+                const float *centerWeights = weights.data() + (size_t)y * paddedElementNum + channelNum;
+                float *imageRow = image + (size_t)y * elementNum;
+                simd::Float zero = simd::broadcast(0.0f);
+                int i = 0;
+                for (; i + simd::kWidth <= elementNum; i += simd::kWidth) {
+                    simd::Float valueSum = simd::load(rowValueSums[0] + i);
+                    simd::Float weightSum = simd::load(rowWeightSums[0] + i);
+                    for (size_t r = 1; r < rowNum; ++r) {
+                        valueSum = valueSum + simd::load(rowValueSums[r] + i);
+                        weightSum = weightSum + simd::load(rowWeightSums[r] + i);
+                    }
+                    simd::Mask fill = simd::equal(simd::load(centerWeights + i), zero) & simd::lessThan(zero, weightSum);
+                    if (0 == simd::bits(fill))
+                        continue;
+                    simd::Float average = valueSum / simd::max(weightSum, simd::broadcast(1.0f));
+                    simd::store(imageRow + i, simd::select(fill, average, simd::load(imageRow + i)));
+                }
+                for (; i < elementNum; ++i) {
+                    float valueSum = 0;
+                    float weightSum = 0;
+                    for (size_t r = 0; r < rowNum; ++r) {
+                        valueSum += rowValueSums[r][i];
+                        weightSum += rowWeightSums[r][i];
+                    }
+                    if (0 == centerWeights[i] && weightSum > 0)
+                        imageRow[i] = valueSum / weightSum;
+                }
+                uint64_t *newCoverageRow = newCoverage.data() + (size_t)y * coverageWordNum;
+                for (int x = 0; x < width; ++x) {
+                    if (isCovered(coverageRow, x))
+                        continue;
+                    float weightSum = 0;
+                    for (size_t r = 0; r < rowNum; ++r)
+                        weightSum += rowWeightSums[r][x * channelNum];
+                    if (weightSum > 0)
+                        newCoverageRow[x >> 6] |= (uint64_t)1 << (x & 63);
+                }
+            }
+        });
+        coverage.swap(newCoverage);
+    }
+}
+
+void dilateGutter(float *image, int channelNum, const UvRaster &raster, int passNum, size_t threadNum)
+{
+    std::vector<uint64_t> coverage = raster.coverage;
+    dilateGutter(image, raster.width, raster.height, channelNum, coverage, raster.coverageWordNum, passNum, threadNum);
+}
+
+}
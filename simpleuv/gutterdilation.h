@@ -0,0 +1,24 @@
+#ifndef SIMPLEUV_GUTTER_DILATION_H
+#define SIMPLEUV_GUTTER_DILATION_H
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+namespace simpleuv
+{
+
+struct UvRaster;
+
+// Bleeds the baked charts outwards, every pass fills each empty texel that touches a covered one
+// with the average of its covered 8 neighbors and marks it covered. The image is width x height texels
+// of channelNum interleaved floats, the coverage has the layout of UvRaster::coverage and is updated.
+// Rows are processed with SIMD over the interleaved channels and split across threads,
+// threadNum 0 means one thread per hardware thread
+void dilateGutter(float *image, int width, int height, int channelNum,
+    std::vector<uint64_t> &coverage, int coverageWordNum, int passNum, size_t threadNum=0);
+// Uses a copy of the raster's coverage, the raster itself is left untouched
+void dilateGutter(float *image, int channelNum, const UvRaster &raster, int passNum, size_t threadNum=0);
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include <unordered_map>
+#include <Eigen/Core>
+#include <igl/PI.h>
+#include <simpleuv/islandmerger.h>
+
+namespace simpleuv
+{
+
+struct NormalCone
+{
+    Eigen::Vector3d axis;
+    double halfAngle;
+};
+
+struct MergingIsland
+{
+    std::vector<Index> faces;
+    // Neighbor island to the number of this island's edges facing it
+    std::unordered_map<Index, size_t> neighbors;
+    long eulerCharacteristic = 0;
+    size_t perimeter = 0;
+    NormalCone cone;
+    unsigned int version = 0;
+    bool alive = true;
+};
+
+struct MergeCandidate
+{
+    double cost;
+    Index from;
+    Index into;
+    unsigned int fromVersion;
+    unsigned int intoVersion;
+    bool operator>(const MergeCandidate &other) const
+    {
+        if (cost != other.cost)
+            return cost > other.cost;
+        if (from != other.from)
+            return from > other.from;
+        return into > other.into;
+    }
+};
+
+// The smallest cone containing both
+static NormalCone mergeCones(const NormalCone &first, const NormalCone &second)
+{
+    double between = std::acos(std::max(-1.0, std::min(1.0, first.axis.dot(second.axis))));
+    if (between + second.halfAngle <= first.halfAngle)
+        return first;
+    if (between + first.halfAngle <= second.halfAngle)
+        return second;
+    NormalCone merged;
+    merged.axis = first.axis;
+    merged.halfAngle = 0.5 * (between + first.halfAngle + second.halfAngle);
+    double sinBetween = std::sin(between);
+    if (merged.halfAngle >= igl::PI || sinBetween < 1e-9) {
+        merged.halfAngle = igl::PI;
+        return merged;
+    }
+    // Turn the first axis towards the second until the cone touches both
+    double turn = merged.halfAngle - first.halfAngle;
+    merged.axis = ((std::sin(between - turn) * first.axis + std::sin(turn) * second.axis) / sinBetween).normalized();
+    return merged;
+}
+
+size_t mergeSmallIslands(const CompactMesh &mesh, const Index *group, size_t groupSize,
+    const std::vector<Index> &oppositeFaces, size_t smallIslandFaceNum, float maxConeAngle,
+    std::vector<Index> &faceIslands, size_t islandNum)
+{
+    bool hasNormals = mesh.faceNormals.size() == mesh.faces.size();
+
+    // The group's corners get compact vertex ids, with the faces around each vertex
+    std::vector<std::pair<Index, Index>> cornerVertices(groupSize * 3);
+    for (size_t i = 0; i < groupSize; ++i) {
+        const auto &face = mesh.faces[group[i]];
+        for (size_t j = 0; j < 3; ++j)
+            cornerVertices[i * 3 + j] = {face.indices[j], (Index)(i * 3 + j)};
+    }
+    std::sort(cornerVertices.begin(), cornerVertices.end());
+    std::vector<Index> cornerVertexIds(groupSize * 3);
+    std::vector<size_t> incidenceOffsets;
+    std::vector<Index> incidentFaces(groupSize * 3);
+    for (size_t k = 0; k < cornerVertices.size(); ++k) {
+        if (0 == k || cornerVertices[k].first != cornerVertices[k - 1].first)
+            incidenceOffsets.push_back(k);
+        cornerVertexIds[cornerVertices[k].second] = (Index)(incidenceOffsets.size() - 1);
+        incidentFaces[k] = cornerVertices[k].second / 3;
+    }
+    size_t vertexNum = incidenceOffsets.size();
+    incidenceOffsets.push_back(cornerVertices.size());
+
+    std::vector<MergingIsland> islands(islandNum);
+    for (size_t i = 0; i < groupSize; ++i) {
+        auto &island = islands[faceIslands[i]];
+        island.faces.push_back((Index)i);
+        for (size_t j = 0; j < 3; ++j) {
+            Index opposite = oppositeFaces[i * 3 + j];
+            if ((Index)-1 != opposite && faceIslands[opposite] == faceIslands[i])
+                continue;
+            ++island.perimeter;
+            if ((Index)-1 != opposite)
+                ++island.neighbors[faceIslands[opposite]];
+        }
+    }
+    std::vector<unsigned int> vertexStamps(vertexNum, 0);
+    unsigned int stamp = 0;
+    for (size_t islandIndex = 0; islandIndex < islandNum; ++islandIndex) {
+        auto &island = islands[islandIndex];
+        ++stamp;
+        long islandVertexNum = 0;
+        for (Index i: island.faces) {
+            for (size_t j = 0; j < 3; ++j) {
+                Index v = cornerVertexIds[i * 3 + j];
+                if (stamp == vertexStamps[v])
+                    continue;
+                vertexStamps[v] = stamp;
+                ++islandVertexNum;
+            }
+        }
+        long faceNum = island.faces.size();
+        long edgeNum = (3 * faceNum + (long)island.perimeter) / 2;
+        island.eulerCharacteristic = islandVertexNum - edgeNum + faceNum;
+        island.cone.axis = Eigen::Vector3d::Zero();
+        island.cone.halfAngle = 0;
+        if (!hasNormals)
+            continue;
+        for (Index i: island.faces) {
+            const auto &normal = mesh.faceNormals[group[i]];
+            island.cone.axis += Eigen::Vector3d(normal.xyz[0], normal.xyz[1], normal.xyz[2]);
+        }
+        if (island.cone.axis.norm() < 1e-9) {
+            island.cone.halfAngle = igl::PI;
+            continue;
+        }
+        island.cone.axis.normalize();
+        for (Index i: island.faces) {
+            const auto &normal = mesh.faceNormals[group[i]];
+            double dot = island.cone.axis.dot(Eigen::Vector3d(normal.xyz[0], normal.xyz[1], normal.xyz[2]));
+            island.cone.halfAngle = std::max(island.cone.halfAngle, std::acos(std::max(-1.0, std::min(1.0, dot))));
+        }
+    }
+
+    auto evaluate = [&](Index from, Index into, long &eulerCharacteristic, NormalCone &cone, size_t &perimeter, double &cost) {
+        const auto &small = islands[from];
+        const auto &large = islands[into];
+        size_t sharedEdgeNum = small.neighbors.at(into);
+        long sharedVertexNum = 0;
+        ++stamp;
+        for (Index i: small.faces) {
+            for (size_t j = 0; j < 3; ++j) {
+                Index v = cornerVertexIds[i * 3 + j];
+                if (stamp == vertexStamps[v])
+                    continue;
+                vertexStamps[v] = stamp;
+                for (size_t k = incidenceOffsets[v]; k < incidenceOffsets[v + 1]; ++k) {
+                    if (faceIslands[incidentFaces[k]] == into) {
+                        ++sharedVertexNum;
+                        break;
+                    }
+                }
+            }
+        }
+        // Sharing more than one run of edges leaves a new hole or handle, sharing a whole boundary closes the island
+        eulerCharacteristic = small.eulerCharacteristic + large.eulerCharacteristic - sharedVertexNum + (long)sharedEdgeNum;
+        if (eulerCharacteristic < small.eulerCharacteristic + large.eulerCharacteristic - 1 || eulerCharacteristic > 1)
+            return false;
+        if (hasNormals) {
+            cone = mergeCones(small.cone, large.cone);
+            if (cone.halfAngle > maxConeAngle && cone.halfAngle > large.cone.halfAngle)
+                return false;
+        } else {
+            cone = large.cone;
+        }
+        perimeter = small.perimeter + large.perimeter - std::min(small.perimeter + large.perimeter, sharedEdgeNum * 2);
+        cost = (hasNormals ? cone.halfAngle : 1.0) * perimeter / (double)(small.perimeter + large.perimeter);
+        return true;
+    };
+
+    std::priority_queue<MergeCandidate, std::vector<MergeCandidate>, std::greater<MergeCandidate>> candidates;
+    auto addCandidate = [&](Index first, Index second) {
+        Index from = first;
+        Index into = second;
+        if (islands[from].faces.size() > islands[into].faces.size() ||
+                (islands[from].faces.size() == islands[into].faces.size() && from < into))
+            std::swap(from, into);
+        if (islands[from].faces.size() >= smallIslandFaceNum)
+            return;
+        long eulerCharacteristic;
+        NormalCone cone;
+        size_t perimeter;
+        double cost;
+        if (!evaluate(from, into, eulerCharacteristic, cone, perimeter, cost))
+            return;
+        candidates.push({cost, from, into, islands[from].version, islands[into].version});
+    };
+    for (size_t islandIndex = 0; islandIndex < islandNum; ++islandIndex) {
+        for (const auto &it: islands[islandIndex].neighbors) {
+            if (it.first > islandIndex)
+                addCandidate((Index)islandIndex, it.first);
+        }
+    }
+
+    size_t mergedNum = 0;
+    while (!candidates.empty()) {
+        MergeCandidate candidate = candidates.top();
+        candidates.pop();
+        auto &small = islands[candidate.from];
+        auto &large = islands[candidate.into];
+        if (!small.alive || !large.alive || small.version != candidate.fromVersion || large.version != candidate.intoVersion)
+            continue;
+        long eulerCharacteristic;
+        NormalCone cone;
+        size_t perimeter;
+        double cost;
+        if (!evaluate(candidate.from, candidate.into, eulerCharacteristic, cone, perimeter, cost))
+            continue;
+        for (Index i: small.faces)
+            faceIslands[i] = candidate.into;
+        large.faces.insert(large.faces.end(), small.faces.begin(), small.faces.end());
+        large.eulerCharacteristic = eulerCharacteristic;
+        large.cone = cone;
+        large.perimeter = perimeter;
+        for (const auto &it: small.neighbors) {
+            if (it.first == candidate.into)
+                continue;
+            large.neighbors[it.first] += it.second;
+            auto &neighborLinks = islands[it.first].neighbors;
+            auto back = neighborLinks.find(candidate.from);
+            if (back != neighborLinks.end()) {
+                neighborLinks[candidate.into] += back->second;
+                neighborLinks.erase(back);
+            }
+        }
+        large.neighbors.erase(candidate.from);
+        small.alive = false;
+        small.faces.clear();
+        small.neighbors.clear();
+        ++small.version;
+        ++large.version;
+        ++mergedNum;
+        for (const auto &it: large.neighbors)
+            addCandidate(candidate.into, it.first);
+    }
+    if (0 == mergedNum)
+        return islandNum;
+
+    std::vector<Index> newIds(islandNum, (Index)-1);
+    size_t newIslandNum = 0;
+    for (size_t i = 0; i < groupSize; ++i) {
+        Index &id = newIds[faceIslands[i]];
+        if ((Index)-1 == id)
+            id = (Index)newIslandNum++;
+        faceIslands[i] = id;
+    }
+    return newIslandNum;
+}
+
+}
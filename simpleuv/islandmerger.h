@@ -0,0 +1,24 @@
+#ifndef SIMPLEUV_ISLAND_MERGER_H
+#define SIMPLEUV_ISLAND_MERGER_H
+#include <vector>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+// Greedily merges adjacent islands of a face group while the smaller of the two has fewer than smallIslandFaceNum faces.
+// A merge must keep the islands disk-like: the two share one run of edges, so no hole or handle is added, and the
+// result is not closed; an island filling a hole of its neighbor is fine. The face normals of the merged island
+// must fit in a cone of maxConeAngle radians half angle, or at least not widen the cone of the larger one.
+// The cheapest merge goes first, the cost is the half angle of the merged cone scaled by the fraction of
+// the two perimeters that stays boundary, so flat pairs sharing a long edge merge first.
+// faceIslands[i] is the island of group[i] and is renumbered to the merged islands, in order of first appearance.
+// oppositeFaces[i * 3 + j] is the face of the group across edge j of group[i], (Index)-1 for none.
+// Without face normals only the topology is checked. Returns the island count after merging
+size_t mergeSmallIslands(const CompactMesh &mesh, const Index *group, size_t groupSize,
+    const std::vector<Index> &oppositeFaces, size_t smallIslandFaceNum, float maxConeAngle,
+    std::vector<Index> &faceIslands, size_t islandNum);
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define SIMPLEUV_MESH_DATA_TYPE_H
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
 
 namespace simpleuv 
 {
@@ -19,6 +20,16 @@ struct Rect
     float top;
     float width;
     float height;
+    int page;
+};
+
+struct PixelRect
+{
+    int left;
+    int top;
+    int width;
+    int height;
+    int page;
 };
 
 struct Face
@@ -36,6 +47,12 @@ struct FaceTextureCoords
     TextureCoord coords[3];
 };
 
+// 2x3 affine map of uv: u' = m[0] * u + m[1] * v + m[2], v' = m[3] * u + m[4] * v + m[5]
+struct UvTransform
+{
+    float m[6];
+};
+
 struct Mesh
 {
     std::vector<Vertex> vertices;
@@ -44,6 +61,34 @@ struct Mesh
     std::vector<int> facePartitions;
 };
 
+// Index type of the internal mesh and chart structures, the public Mesh is converted when it's set.
+// Define SIMPLEUV_64BIT_INDEX for meshes with 2^32 or more vertices or faces.
+#ifdef SIMPLEUV_64BIT_INDEX
+typedef size_t Index;
+#else
+typedef uint32_t Index;
+#endif
+
+struct CompactFace
+{
+    Index indices[3];
+};
+
+struct CompactMesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<CompactFace> faces;
+    std::vector<Vector3> faceNormals;
+    std::vector<int> facePartitions;
+};
+
+// These are mapped as plain float and index arrays
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be tightly packed");
+static_assert(sizeof(TextureCoord) == 2 * sizeof(float), "TextureCoord must be tightly packed");
+static_assert(sizeof(FaceTextureCoords) == 6 * sizeof(float), "FaceTextureCoords must be tightly packed");
+static_assert(sizeof(Face) == 3 * sizeof(size_t), "Face must be tightly packed");
+static_assert(sizeof(CompactFace) == 3 * sizeof(Index), "CompactFace must be tightly packed");
+
 float dotProduct(const Vector3 &first, const Vector3 &second);
 Vector3 crossProduct(const Vector3 &first, const Vector3 &second);
 
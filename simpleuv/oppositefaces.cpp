@@ -0,0 +1,36 @@
+#include <tuple>
+#include <limits>
+#include <algorithm>
+#include <simpleuv/oppositefaces.h>
+
+namespace simpleuv
+{
+
+void buildOppositeFaces(const std::vector<CompactFace> &faces, const Index *group, size_t groupSize,
+    std::vector<Index> &oppositeFaces)
+{
+    // One sorted array of the half edges instead of a tree, the reversed edge is found by binary search
+    std::vector<std::tuple<Index, Index, Index>> halfEdges(groupSize * 3);
+    for (size_t index = 0; index < groupSize; ++index) {
+        const auto &face = faces[group[index]];
+        for (size_t i = 0; i < 3; i++)
+            halfEdges[index * 3 + i] = std::make_tuple(face.indices[i], face.indices[(i + 1) % 3], (Index)index);
+    }
+    std::sort(halfEdges.begin(), halfEdges.end());
+    oppositeFaces.resize(groupSize * 3);
+    for (size_t index = 0; index < groupSize; ++index) {
+        const auto &face = faces[group[index]];
+        for (size_t i = 0; i < 3; i++) {
+            Index from = face.indices[(i + 1) % 3];
+            Index to = face.indices[i];
+            auto it = std::upper_bound(halfEdges.begin(), halfEdges.end(),
+                std::make_tuple(from, to, std::numeric_limits<Index>::max()));
+            if (it != halfEdges.begin() && std::get<0>(*(it - 1)) == from && std::get<1>(*(it - 1)) == to)
+                oppositeFaces[index * 3 + i] = std::get<2>(*(it - 1));
+            else
+                oppositeFaces[index * 3 + i] = (Index)-1;
+        }
+    }
+}
+
+}
@@ -0,0 +1,17 @@
+#ifndef SIMPLEUV_OPPOSITE_FACES_H
+#define SIMPLEUV_OPPOSITE_FACES_H
+#include <vector>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+// oppositeFaces[i * 3 + j] is the index into group of the face across edge j of faces[group[i]], the edge
+// from corner j to corner j + 1, or (Index)-1 when no face of the group has it reversed.
+// On a non manifold edge the last of the faces in group order is taken
+void buildOppositeFaces(const std::vector<CompactFace> &faces, const Index *group, size_t groupSize,
+    std::vector<Index> &oppositeFaces);
+
+}
+
+#endif
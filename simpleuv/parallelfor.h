@@ -0,0 +1,37 @@
+#ifndef SIMPLEUV_PARALLEL_FOR_H
+#define SIMPLEUV_PARALLEL_FOR_H
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+namespace simpleuv
+{
+
+// Splits [0, num) into one contiguous range per thread and calls function(begin, end) for each,
+// the calling thread takes the first range. threadNum 0 means one thread per hardware thread
+template <class Function>
+void parallelFor(size_t num, size_t threadNum, Function function)
+{
+    if (0 == threadNum)
+        threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+    threadNum = std::max((size_t)1, std::min(threadNum, num));
+    if (1 == threadNum) {
+        function((size_t)0, num);
+        return;
+    }
+    size_t numPerThread = (num + threadNum - 1) / threadNum;
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadNum; ++i) {
+        size_t begin = std::min(num, i * numPerThread);
+        size_t end = std::min(num, begin + numPerThread);
+        threads.push_back(std::thread(function, begin, end));
+    }
+    function((size_t)0, std::min(num, numPerThread));
+    for (auto &thread: threads)
+        thread.join();
+}
+
+}
+
+#endif
@@ -1,40 +1,53 @@
-#include <igl/arap.h>
-#include <igl/lscm.h>
 #include <igl/boundary_loop.h>
-#include <igl/harmonic.h>
 #include <igl/map_vertices_to_circle.h>
+#include <type_traits>
 #include <simpleuv/parametrize.h>
+#include <simpleuv/simd.h>
+#include <simpleuv/arapsolver.h>
+#include <simpleuv/boundaryfirstflattening.h>
 
 namespace simpleuv
 {
 
-void parametrizeUsingARAP(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd, Eigen::MatrixXd &V_uv)
+bool parametrizeUsingARAP(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd, Eigen::MatrixXd &V_uv,
+    const ArapOptions &options)
 {
     Eigen::MatrixXd initial_guess;
     Eigen::MatrixXd bnd_uv;
     igl::map_vertices_to_circle(V,bnd,bnd_uv);
 
-    igl::harmonic(V,F,bnd,bnd_uv,1,initial_guess);
-
-    // Add dynamic regularization to avoid to specify boundary conditions
-    igl::ARAPData arap_data;
-    arap_data.with_dynamics = true;
-    Eigen::VectorXi b  = Eigen::VectorXi::Zero(0);
-    Eigen::MatrixXd bc = Eigen::MatrixXd::Zero(0,0);
-
-    // Initialize ARAP
-    arap_data.max_iter = 100;
-    // 2 means that we're going to *solve* in 2d
-    arap_precomputation(V,F,2,b,arap_data);
-
+    // Add dynamic regularization to avoid to specify boundary conditions,
+    // the solver falls back to conjugate gradients when the factorization wouldn't fit the memory budget
+    ArapSolver solver(options);
+    if (!solver.solveHarmonic(V,F,bnd,bnd_uv,initial_guess))
+        return false;
+    if (!solver.precompute(V,F))
+        return false;
 
     // Solve arap using the harmonic map as initial guess
     V_uv = initial_guess;
 
-    arap_solve(bc,arap_data,V_uv);
+    return solver.solve(V_uv);
 }
 
-void parametrizeUsingLSCM(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd, Eigen::MatrixXd &V_uv)
+static const double kMaxBffAreaDistortion = 16;
+
+bool parametrizeUsingBFF(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd, Eigen::MatrixXd &V_uv,
+    const ArapOptions &options)
+{
+    // Zero boundary scale factors, the conformal map with the least area distortion
+    BoundaryFirstFlattening flattening;
+    flattening.setThreadNum(options.threadNum);
+    if (!flattening.precompute(V,F,bnd))
+        return false;
+    if (!flattening.flatten(V_uv))
+        return false;
+    // Past this the conformal map squeezes part of the island too much, ARAP spreads the area better
+    return flattening.getAreaDistortion() <= kMaxBffAreaDistortion;
+}
+
+bool parametrizeUsingLSCM(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::VectorXi &bnd, Eigen::MatrixXd &V_uv,
+    const ArapOptions &options)
 {
     Eigen::VectorXi b(2,1);
     b(0) = bnd(0);
@@ -42,76 +55,131 @@ void parametrizeUsingLSCM(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, co
     Eigen::MatrixXd bc(2,2);
     bc<<0,0,1,0;
 
-    // LSCM parametrization
-    igl::lscm(V,F,b,bc,V_uv);
+    // LSCM parametrization, through the same backend choice as ARAP so the fallback keeps to the memory budget
+    ArapSolver solver(options);
+    return solver.solveLscm(V,F,b,bc,V_uv);
 }
 
-bool extractResult(const std::vector<Vertex> &verticies, const Eigen::MatrixXd &V_uv, std::vector<TextureCoord> &vertexUvs)
+static bool isUvBufferValid(const TextureCoord *vertexUvs, size_t vertexNum)
 {
-    vertexUvs.clear();
-    auto isCoordValid = [=](float coord) {
-        if (std::isnan(coord) || std::isinf(coord))
-            return false;
-        return true;
-    };
-    if ((decltype(verticies.size()))V_uv.size() < verticies.size() * 2) {
-        //qDebug() << "Invalid V_uv.size:" << V_uv.size() << "Expected:" << verticies.size() * 2;
+    const float *values = vertexUvs[0].uv;
+    size_t valueNum = vertexNum * 2;
+    size_t i = 0;
+    simd::Mask valid = simd::isFinite(simd::broadcast(0.0f));
+    for (; i + simd::kWidth <= valueNum; i += simd::kWidth)
+        valid = valid & simd::isFinite(simd::load(values + i));
+    if (simd::bits(valid) != simd::allBits())
         return false;
+    for (; i < valueNum; ++i) {
+        if (std::isnan(values[i]) || std::isinf(values[i]))
+            return false;
     }
-    for (decltype(verticies.size()) i = 0; i < verticies.size(); i++) {
-        TextureCoord coord;
-        coord.uv[0] = V_uv.row(i)[0];
-        coord.uv[1] = V_uv.row(i)[1];
-        if (isCoordValid(coord.uv[0]) && isCoordValid(coord.uv[1])) {
-            vertexUvs.push_back(coord);
-            continue;
-        }
-        vertexUvs.clear();
+    return true;
+}
+
+static bool extractResult(const Eigen::MatrixXd &V_uv, const Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> &permutation,
+    size_t vertexNum, TextureCoord *vertexUvs)
+{
+    if ((size_t)V_uv.rows() != vertexNum || V_uv.cols() < 2) {
+        //qDebug() << "Invalid V_uv.size:" << V_uv.rows() << "x" << V_uv.cols() << "Expected:" << vertexNum << "x" << 2;
         return false;
     }
-    return true;
+    // The doubles are narrowed to float before validating, so values overflowing float are rejected too
+    Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, 2, Eigen::RowMajor>> uvs(vertexUvs[0].uv, vertexNum, 2);
+    uvs = (permutation.transpose() * V_uv.leftCols(2)).cast<float>();
+    return isUvBufferValid(vertexUvs, vertexNum);
 }
 
 // Modified from the libigl example code
 // https://github.com/libigl/libigl/blob/master/tutorial/503_ARAPParam/main.cpp
-bool parametrize(const std::vector<Vertex> &verticies,
-        const std::vector<Face> &faces, 
-        std::vector<TextureCoord> &vertexUvs)
+template <class FaceType>
+static bool parametrizeImpl(const std::vector<Vertex> &verticies,
+        const std::vector<FaceType> &faces, 
+        TextureCoord *vertexUvs,
+        const ArapOptions &options,
+        ParametrizationMethod method)
 {
     if (verticies.empty() || faces.empty())
         return false;
     
-    Eigen::MatrixXd V(verticies.size(), 3);
-    Eigen::MatrixXi F(faces.size(), 3);
-
-    for (decltype(verticies.size()) i = 0; i < verticies.size(); i++) {
-        const auto &vertex = verticies[i];
-        V.row(i) << vertex.xyz[0], vertex.xyz[1], vertex.xyz[2];
-    }
-
-    for (decltype(faces.size()) i = 0; i < faces.size(); i++) {
-        const auto &face = faces[i];
-        F.row(i) << face.indices[0], face.indices[1], face.indices[2];
-    }
+    // The caller's buffers are mapped in place and converted with one Eigen expression each,
+    // libigl still needs its own column major double and int copies to solve on
+    typedef typename std::remove_extent<decltype(FaceType::indices)>::type IndexType;
+    Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>> vertexMap(verticies[0].xyz, verticies.size(), 3);
+    Eigen::Map<const Eigen::Matrix<IndexType, Eigen::Dynamic, 3, Eigen::RowMajor>> faceMap(faces[0].indices, faces.size(), 3);
+    Eigen::MatrixXd V = vertexMap.template cast<double>();
+    Eigen::MatrixXi F = faceMap.template cast<int>();
+
+    // Renumber the vertices so the matrices built on them have a tight pattern, the result rows are permuted back
+    Eigen::VectorXi positions;
+    calculateVertexOrdering(V.rows(), F, options.vertexOrdering, positions);
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> permutation(positions);
+    V = permutation * V;
+    F = F.unaryExpr([&](int v) { return positions(v); }).eval();
 
     Eigen::VectorXi bnd;
     igl::boundary_loop(F,bnd);
+
+    if (ParametrizationMethod::BoundaryFirstFlattening == method) {
+        Eigen::MatrixXd V_uv;
+        if (parametrizeUsingBFF(V, F, bnd, V_uv, options) && extractResult(V_uv, permutation, verticies.size(), vertexUvs))
+            return true;
+    }
     
     {
         Eigen::MatrixXd V_uv;
-        parametrizeUsingARAP(V, F, bnd, V_uv);
-        if (extractResult(verticies, V_uv, vertexUvs))
+        if (parametrizeUsingARAP(V, F, bnd, V_uv, options) && extractResult(V_uv, permutation, verticies.size(), vertexUvs))
             return true;
     }
 
     {
         Eigen::MatrixXd V_uv;
-        parametrizeUsingLSCM(V, F, bnd, V_uv);
-        if (extractResult(verticies, V_uv, vertexUvs))
+        if (parametrizeUsingLSCM(V, F, bnd, V_uv, options) && extractResult(V_uv, permutation, verticies.size(), vertexUvs))
             return true;
     }
     
     return false;
 }
 
+template <class FaceType>
+static bool parametrizeToVector(const std::vector<Vertex> &verticies,
+        const std::vector<FaceType> &faces, 
+        std::vector<TextureCoord> &vertexUvs,
+        const ArapOptions &options,
+        ParametrizationMethod method)
+{
+    vertexUvs.resize(verticies.size());
+    if (parametrizeImpl(verticies, faces, vertexUvs.data(), options, method))
+        return true;
+    vertexUvs.clear();
+    return false;
+}
+
+bool parametrize(const std::vector<Vertex> &verticies,
+        const std::vector<Face> &faces, 
+        std::vector<TextureCoord> &vertexUvs,
+        const ArapOptions &options,
+        ParametrizationMethod method)
+{
+    return parametrizeToVector(verticies, faces, vertexUvs, options, method);
+}
+
+bool parametrize(const std::vector<Vertex> &verticies,
+        const std::vector<CompactFace> &faces, 
+        std::vector<TextureCoord> &vertexUvs,
+        const ArapOptions &options,
+        ParametrizationMethod method)
+{
+    return parametrizeToVector(verticies, faces, vertexUvs, options, method);
+}
+
+bool parametrize(const std::vector<Vertex> &verticies,
+        const std::vector<CompactFace> &faces, 
+        TextureCoord *vertexUvs,
+        const ArapOptions &options,
+        ParametrizationMethod method)
+{
+    return parametrizeImpl(verticies, faces, vertexUvs, options, method);
+}
+
 }
@@ -1,13 +1,37 @@
 #ifndef SIMPLEUV_PARAMETRIZE_H
 #define SIMPLEUV_PARAMETRIZE_H
 #include <simpleuv/meshdatatype.h>
+#include <simpleuv/arapsolver.h>
 
 namespace simpleuv
 {
 
+enum class ParametrizationMethod
+{
+    // As rigid as possible, the least distortion but up to ArapOptions::iterationNum iterations
+    Arap,
+    // Conformal with a free boundary in two solves on one factorization, between LSCM and ARAP in quality and speed.
+    // Islands with more than one boundary fall back to ARAP
+    BoundaryFirstFlattening
+};
+
 bool parametrize(const std::vector<Vertex> &verticies, 
         const std::vector<Face> &faces, 
-        std::vector<TextureCoord> &vertexUvs);
+        std::vector<TextureCoord> &vertexUvs,
+        const ArapOptions &options=ArapOptions(),
+        ParametrizationMethod method=ParametrizationMethod::Arap);
+bool parametrize(const std::vector<Vertex> &verticies, 
+        const std::vector<CompactFace> &faces, 
+        std::vector<TextureCoord> &vertexUvs,
+        const ArapOptions &options=ArapOptions(),
+        ParametrizationMethod method=ParametrizationMethod::Arap);
+
+// Writes verticies.size() coords into vertexUvs, the content is undefined when it returns false
+bool parametrize(const std::vector<Vertex> &verticies, 
+        const std::vector<CompactFace> &faces, 
+        TextureCoord *vertexUvs,
+        const ArapOptions &options=ArapOptions(),
+        ParametrizationMethod method=ParametrizationMethod::Arap);
 
 }
 
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <simpleuv/rasterchartpacker.h>
+#include <simpleuv/uvtransform.h>
+
+namespace simpleuv
+{
+
+// Every placement searches the rows on all the threads, so they wait between placements instead of being started again
+class RowSearchWorkers
+{
+public:
+    explicit RowSearchWorkers(size_t threadNum);
+    ~RowSearchWorkers();
+    size_t threadNum() const;
+    // Calls search(threadIndex) on every thread, the calling thread being 0, and returns once all of them finished
+    void run(const std::function<void(size_t)> &search);
+
+private:
+    void work(size_t threadIndex);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_finishCondition;
+    const std::function<void(size_t)> *m_search = nullptr;
+    size_t m_generation = 0;
+    size_t m_runningNum = 0;
+    bool m_stopping = false;
+};
+
+RowSearchWorkers::RowSearchWorkers(size_t threadNum)
+{
+    for (size_t i = 1; i < threadNum; ++i)
+        m_threads.push_back(std::thread(&RowSearchWorkers::work, this, i));
+}
+
+RowSearchWorkers::~RowSearchWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_startCondition.notify_all();
+    for (auto &thread: m_threads)
+        thread.join();
+}
+
+size_t RowSearchWorkers::threadNum() const
+{
+    return m_threads.size() + 1;
+}
+
+void RowSearchWorkers::run(const std::function<void(size_t)> &search)
+{
+    if (m_threads.empty()) {
+        search(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_search = &search;
+        m_runningNum = m_threads.size();
+        ++m_generation;
+    }
+    m_startCondition.notify_all();
+    search(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finishCondition.wait(lock, [&]() {return 0 == m_runningNum;});
+}
+
+void RowSearchWorkers::work(size_t threadIndex)
+{
+    size_t generation = 0;
+    while (true) {
+        const std::function<void(size_t)> *search = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_startCondition.wait(lock, [&]() {return m_stopping || m_generation != generation;});
+            if (m_stopping)
+                return;
+            generation = m_generation;
+            search = m_search;
+        }
+        (*search)(threadIndex);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (0 == --m_runningNum)
+            m_finishCondition.notify_one();
+    }
+}
+
+void RasterChartPacker::BitMap::resize(int newWidth, int newHeight, int extraWordNum)
+{
+    width = newWidth;
+    height = newHeight;
+    wordNum = (width + 63) / 64 + extraWordNum;
+    words.assign((size_t)wordNum * height, 0);
+}
+
+void RasterChartPacker::setResolution(int resolution)
+{
+    m_resolution = resolution;
+}
+
+void RasterChartPacker::setPaddingPixels(int paddingPixels)
+{
+    m_paddingPixels = paddingPixels;
+}
+
+void RasterChartPacker::setThreadNum(size_t threadNum)
+{
+    m_threadNum = threadNum;
+}
+
+const std::vector<std::tuple<float, float, float, float, bool>> &RasterChartPacker::getResult()
+{
+    return m_result;
+}
+
+void RasterChartPacker::addChart(const FaceTextureCoords *uvs, size_t faceNum, const UvTransform &transform,
+    const std::pair<float, float> &size)
+{
+    m_chartUvs.push_back(std::vector<FaceTextureCoords>(faceNum));
+    transformUvs(uvs, faceNum, transform, m_chartUvs.back().data());
+    m_chartSizes.push_back(size);
+}
+
+static int popCount(uint64_t word)
+{
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int)((word * 0x0101010101010101ull) >> 56);
+}
+
+static void dilateRowOnce(uint64_t *words, int wordNum)
+{
+    uint64_t carryFromLower = 0;
+    for (int k = 0; k < wordNum; ++k) {
+        uint64_t word = words[k];
+        uint64_t higher = k + 1 < wordNum ? words[k + 1] : 0;
+        words[k] = word | (word << 1) | (word >> 1) | carryFromLower | (higher << 63);
+        carryFromLower = word >> 63;
+    }
+}
+
+void RasterChartPacker::rasterizeChart(size_t chartIndex, float pixelsPerUnit, BitMap &mask)
+{
+    const auto &chartSize = m_chartSizes[chartIndex];
+    int padding = m_paddingPixels;
+    mask.resize((int)std::ceil(chartSize.first * pixelsPerUnit) + padding * 2,
+        (int)std::ceil(chartSize.second * pixelsPerUnit) + padding * 2);
+    for (const auto &face: m_chartUvs[chartIndex]) {
+        double x[3], y[3];
+        for (size_t i = 0; i < 3; ++i) {
+            x[i] = face.coords[i].uv[0] * pixelsPerUnit + padding;
+            y[i] = face.coords[i].uv[1] * pixelsPerUnit + padding;
+        }
+        int minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+        int maxX = std::min(mask.width - 1, (int)std::floor(std::max(x[0], std::max(x[1], x[2]))));
+        int minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+        int maxY = std::min(mask.height - 1, (int)std::floor(std::max(y[0], std::max(y[1], y[2]))));
+        double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        // Conservative edge functions, a pixel is covered when the triangle touches any part of it,
+        // so each edge is tested at the pixel corner that's furthest inside
+        double a[3], b[3], c[3];
+        for (size_t i = 0; i < 3; ++i) {
+            size_t j = (i + 1) % 3;
+            a[i] = y[i] - y[j];
+            b[i] = x[j] - x[i];
+            c[i] = x[i] * y[j] - x[j] * y[i];
+            if (area < 0) {
+                a[i] = -a[i];
+                b[i] = -b[i];
+                c[i] = -c[i];
+            }
+        }
+        for (int py = minY; py <= maxY; ++py) {
+            uint64_t *row = mask.row(py);
+            for (int px = minX; px <= maxX; ++px) {
+                bool covered = true;
+                if (0 != area) {
+                    for (size_t i = 0; i < 3 && covered; ++i) {
+                        double e = a[i] * (px + 0.5) + b[i] * (py + 0.5) + c[i] + 0.5 * (std::abs(a[i]) + std::abs(b[i]));
+                        covered = e >= 0;
+                    }
+                }
+                if (covered)
+                    row[px >> 6] |= (uint64_t)1 << (px & 63);
+            }
+        }
+    }
+    for (int i = 0; i < padding; ++i) {
+        for (int py = 0; py < mask.height; ++py)
+            dilateRowOnce(mask.row(py), mask.wordNum);
+    }
+    if (padding > 0) {
+        std::vector<uint64_t> source;
+        for (int i = 0; i < padding; ++i) {
+            source = mask.words;
+            for (int py = 0; py < mask.height; ++py) {
+                uint64_t *row = mask.row(py);
+                for (int neighbor = py - 1; neighbor <= py + 1; neighbor += 2) {
+                    if (neighbor < 0 || neighbor >= mask.height)
+                        continue;
+                    const uint64_t *neighborRow = source.data() + (size_t)neighbor * mask.wordNum;
+                    for (int k = 0; k < mask.wordNum; ++k)
+                        row[k] |= neighborRow[k];
+                }
+            }
+        }
+    }
+}
+
+static bool masksOverlap(const uint64_t *atlasRow, const uint64_t *maskRow, int maskWordNum, int left)
+{
+    // The atlas rows have one extra word, so the bits shifted out of the last mask word still land inside
+    int wordOffset = left >> 6;
+    int shift = left & 63;
+    atlasRow += wordOffset;
+    if (0 == shift) {
+        for (int k = 0; k < maskWordNum; ++k) {
+            if (atlasRow[k] & maskRow[k])
+                return true;
+        }
+        return false;
+    }
+    for (int k = 0; k < maskWordNum; ++k) {
+        uint64_t word = maskRow[k];
+        if (0 == word)
+            continue;
+        if ((atlasRow[k] & (word << shift)) || (atlasRow[k + 1] & (word >> (64 - shift))))
+            return true;
+    }
+    return false;
+}
+
+// The first clear bit at or after from, the bits past the width are clear
+static int findClearBit(const uint64_t *row, int wordNum, int from)
+{
+    int k = from >> 6;
+    if (k >= wordNum)
+        return wordNum * 64;
+    uint64_t clear = ~row[k] & (~(uint64_t)0 << (from & 63));
+    while (0 == clear) {
+        if (++k >= wordNum)
+            return wordNum * 64;
+        clear = ~row[k];
+    }
+    return k * 64 + popCount((clear & (0 - clear)) - 1);
+}
+
+bool RasterChartPacker::findPosition(const BitMap &atlas, int firstRow, const BitMap &mask, RowSearchWorkers &workers,
+    int &left, int &top)
+{
+    int lastTop = atlas.height - mask.height;
+    int lastLeft = atlas.width - mask.width;
+    if (lastTop < firstRow || lastLeft < 0)
+        return false;
+    std::vector<int> firstBits(mask.height, -1);
+    for (int r = 0; r < mask.height; ++r) {
+        const uint64_t *maskRow = mask.row(r);
+        for (int k = 0; k < mask.wordNum && -1 == firstBits[r]; ++k) {
+            if (maskRow[k])
+                firstBits[r] = k * 64 + popCount((maskRow[k] & (0 - maskRow[k])) - 1);
+        }
+    }
+    // The first mask row overlapping at x, y, or -1 when the mask fits there
+    auto findOverlappingRow = [&](int x, int y) {
+        for (int r = 0; r < mask.height; ++r) {
+            if (masksOverlap(atlas.row(y + r), mask.row(r), mask.wordNum, x))
+                return r;
+        }
+        return -1;
+    };
+    // Rows are dealt to the threads interleaved, a thread stops once it passed the best row found so far,
+    // so the result is the lowest row and the leftmost position in it, whatever the thread count
+    std::atomic<int> bestTop(std::numeric_limits<int>::max());
+    std::vector<int> bestLefts(lastTop + 1 - firstRow, -1);
+    auto searchRows = [&](int rowBegin, int rowStep) {
+        for (int y = rowBegin; y <= lastTop && y < bestTop.load(); y += rowStep) {
+            for (int x = 0; x <= lastLeft; ) {
+                int r = findOverlappingRow(x, y);
+                if (-1 != r) {
+                    // No position fits before the first pixel of the overlapping mask row lands on a clear atlas pixel
+                    int next = findClearBit(atlas.row(y + r), atlas.wordNum, x + firstBits[r]) - firstBits[r];
+                    x = std::max(x + 1, next);
+                    continue;
+                }
+                bestLefts[y - firstRow] = x;
+                int current = bestTop.load();
+                while (y < current && !bestTop.compare_exchange_weak(current, y))
+                    ;
+                return;
+            }
+        }
+    };
+    size_t threadNum = workers.threadNum();
+    size_t candidateNum = (size_t)(lastTop + 1 - firstRow) * (lastLeft + 1);
+    if (threadNum <= 1 || candidateNum * mask.height < 1 << 16) {
+        searchRows(firstRow, 1);
+    } else {
+        workers.run([&](size_t threadIndex) {
+            searchRows(firstRow + (int)threadIndex, (int)threadNum);
+        });
+    }
+    if (std::numeric_limits<int>::max() == bestTop.load())
+        return false;
+    top = bestTop.load();
+    left = bestLefts[top - firstRow];
+    return true;
+}
+
+bool RasterChartPacker::tryPack(float pixelsPerUnit, RowSearchWorkers &workers)
+{
+    std::vector<BitMap> masks(m_chartSizes.size());
+    for (size_t i = 0; i < masks.size(); ++i)
+        rasterizeChart(i, pixelsPerUnit, masks[i]);
+    std::vector<size_t> order(masks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t first, size_t second) {
+        return (size_t)masks[first].width * masks[first].height > (size_t)masks[second].width * masks[second].height;
+    });
+    BitMap atlas;
+    atlas.resize(m_resolution, m_resolution, 1);
+    int firstFreeRow = 0;
+    m_result.resize(masks.size());
+    for (const auto &chartIndex: order) {
+        const auto &mask = masks[chartIndex];
+        int left = 0;
+        int top = 0;
+        if (!findPosition(atlas, firstFreeRow, mask, workers, left, top))
+            return false;
+        int shift = left & 63;
+        for (int r = 0; r < mask.height; ++r) {
+            uint64_t *atlasRow = atlas.row(top + r) + (left >> 6);
+            const uint64_t *maskRow = mask.row(r);
+            for (int k = 0; k < mask.wordNum; ++k) {
+                atlasRow[k] |= maskRow[k] << shift;
+                if (shift)
+                    atlasRow[k + 1] |= maskRow[k] >> (64 - shift);
+            }
+        }
+        // Rows filled up to the last pixel will never take anything again
+        while (firstFreeRow < atlas.height) {
+            const uint64_t *row = atlas.row(firstFreeRow);
+            int fullWordNum = atlas.width / 64;
+            bool full = true;
+            for (int k = 0; k < fullWordNum && full; ++k)
+                full = ~(uint64_t)0 == row[k];
+            int remainingBits = atlas.width & 63;
+            if (full && remainingBits)
+                full = (((uint64_t)1 << remainingBits) - 1) == (row[fullWordNum] & (((uint64_t)1 << remainingBits) - 1));
+            if (!full)
+                break;
+            ++firstFreeRow;
+        }
+        const auto &chartSize = m_chartSizes[chartIndex];
+        auto &dest = m_result[chartIndex];
+        std::get<0>(dest) = (float)(left + m_paddingPixels) / m_resolution;
+        std::get<1>(dest) = (float)(top + m_paddingPixels) / m_resolution;
+        std::get<2>(dest) = chartSize.first * pixelsPerUnit / m_resolution;
+        std::get<3>(dest) = chartSize.second * pixelsPerUnit / m_resolution;
+        std::get<4>(dest) = false;
+    }
+    return true;
+}
+
+float RasterChartPacker::pack()
+{
+    if (m_chartSizes.empty() || m_resolution <= 0)
+        return 0;
+    double totalArea = 0;
+    for (const auto &chartSize: m_chartSizes)
+        totalArea += chartSize.first * chartSize.second;
+    if (totalArea <= 0)
+        return 0;
+    // Start from the scale where the rasterized footprints, not the rects, would fill the atlas
+    float pixelsPerUnit = m_resolution / std::sqrt(totalArea * m_initialAreaGuessFactor);
+    size_t coveredPixelNum = 0;
+    for (size_t i = 0; i < m_chartSizes.size(); ++i) {
+        BitMap mask;
+        rasterizeChart(i, pixelsPerUnit, mask);
+        for (const auto &word: mask.words)
+            coveredPixelNum += popCount(word);
+    }
+    if (coveredPixelNum > 0)
+        pixelsPerUnit *= std::sqrt((double)m_resolution * m_resolution / (coveredPixelNum * m_initialAreaGuessFactor));
+    size_t threadNum = m_threadNum;
+    if (0 == threadNum)
+        threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+    RowSearchWorkers workers(threadNum);
+    for (size_t tryNum = 0; tryNum < m_maxTryNum; ++tryNum) {
+        if (tryPack(pixelsPerUnit, workers))
+            return m_resolution / pixelsPerUnit;
+        pixelsPerUnit *= m_scaleShrinkFactor;
+    }
+    //qDebug() << "Raster pack tried too many times";
+    m_result.clear();
+    return m_resolution / pixelsPerUnit;
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef SIMPLEUV_RASTER_CHART_PACKER_H
+#define SIMPLEUV_RASTER_CHART_PACKER_H
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+class RowSearchWorkers;
+
+// Packs the actual chart footprints instead of their bounding rects. Every chart is rasterized
+// conservatively into a bit mask at the target resolution and dilated by the padding, then placed
+// at the lowest, leftmost position where its mask doesn't overlap the atlas occupancy bitmap.
+// The overlap test works on 64 bit words, the candidate rows are searched on several threads
+// which are started once per pack().
+class RasterChartPacker
+{
+public:
+    void setResolution(int resolution);
+    void setPaddingPixels(int paddingPixels);
+    void setThreadNum(size_t threadNum);
+    // The transform maps the uvs into [0, size.first] x [0, size.second]
+    void addChart(const FaceTextureCoords *uvs, size_t faceNum, const UvTransform &transform,
+        const std::pair<float, float> &size);
+    // Returns the texture size in the unit of the chart sizes, the result is the same as ChartPacker's
+    float pack();
+    const std::vector<std::tuple<float, float, float, float, bool>> &getResult();
+
+private:
+    struct BitMap
+    {
+        int width = 0;
+        int height = 0;
+        int wordNum = 0;
+        std::vector<uint64_t> words;
+
+        void resize(int newWidth, int newHeight, int extraWordNum=0);
+        uint64_t *row(int y) {return words.data() + (size_t)y * wordNum;}
+        const uint64_t *row(int y) const {return words.data() + (size_t)y * wordNum;}
+    };
+
+    void rasterizeChart(size_t chartIndex, float pixelsPerUnit, BitMap &mask);
+    bool tryPack(float pixelsPerUnit, RowSearchWorkers &workers);
+    bool findPosition(const BitMap &atlas, int firstRow, const BitMap &mask, RowSearchWorkers &workers, int &left, int &top);
+
+    std::vector<std::vector<FaceTextureCoords>> m_chartUvs;
+    std::vector<std::pair<float, float>> m_chartSizes;
+    std::vector<std::tuple<float, float, float, float, bool>> m_result;
+    int m_resolution = 1024;
+    int m_paddingPixels = 2;
+    size_t m_threadNum = 0;
+    float m_initialAreaGuessFactor = 1.1;
+    float m_scaleShrinkFactor = 0.95;
+    size_t m_maxTryNum = 100;
+};
+
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef SIMPLEUV_SIMD_H
+#define SIMPLEUV_SIMD_H
+#include <cmath>
+
+// Thin wrapper over the native float vector of the target, so the kernels can be written once.
+// Build with -mavx2 -mfma (x86) to get 8 lanes, SSE2 is the x86-64 baseline with 4 lanes,
+// NEON gives 4 lanes on ARM, everything else falls back to scalar code.
+// swapPairs (exchanging lanes 0 and 1, 2 and 3, ...) only exists when the width is even.
+
+#if defined(__AVX__)
+#define SIMPLEUV_SIMD_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMPLEUV_SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMPLEUV_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMPLEUV_SIMD_SCALAR 1
+#endif
+
+namespace simpleuv
+{
+namespace simd
+{
+
+#if defined(SIMPLEUV_SIMD_AVX)
+
+const int kWidth = 8;
+struct Float { __m256 v; };
+struct Mask { __m256 v; };
+
+inline Float load(const float *p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float *p, Float a) { _mm256_storeu_ps(p, a.v); }
+inline Float broadcast(float x) { return {_mm256_set1_ps(x)}; }
+inline Float operator+(Float a, Float b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Float operator/(Float a, Float b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Float min(Float a, Float b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Float sqrt(Float a) { return {_mm256_sqrt_ps(a.v)}; }
+inline Float abs(Float a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+#if defined(__FMA__)
+inline Float mulAdd(Float a, Float b, Float c) { return {_mm256_fmadd_ps(a.v, b.v, c.v)}; }
+#else
+inline Float mulAdd(Float a, Float b, Float c) { return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)}; }
+#endif
+inline Mask lessThan(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline Mask lessEqual(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline Mask greaterEqual(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+inline Mask equal(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm256_or_ps(a.v, b.v)}; }
+inline Float select(Mask m, Float a, Float b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+inline int bits(Mask m) { return _mm256_movemask_ps(m.v); }
+inline Float swapPairs(Float a) { return {_mm256_permute_ps(a.v, 0xB1)}; }
+
+#elif defined(SIMPLEUV_SIMD_SSE)
+
+const int kWidth = 4;
+struct Float { __m128 v; };
+struct Mask { __m128 v; };
+
+inline Float load(const float *p) { return {_mm_loadu_ps(p)}; }
+inline void store(float *p, Float a) { _mm_storeu_ps(p, a.v); }
+inline Float broadcast(float x) { return {_mm_set1_ps(x)}; }
+inline Float operator+(Float a, Float b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float operator/(Float a, Float b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float min(Float a, Float b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Float sqrt(Float a) { return {_mm_sqrt_ps(a.v)}; }
+inline Float abs(Float a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+inline Float mulAdd(Float a, Float b, Float c) { return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)}; }
+inline Mask lessThan(Float a, Float b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask lessEqual(Float a, Float b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Mask greaterEqual(Float a, Float b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Mask equal(Float a, Float b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm_or_ps(a.v, b.v)}; }
+inline Float select(Mask m, Float a, Float b) { return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))}; }
+inline int bits(Mask m) { return _mm_movemask_ps(m.v); }
+inline Float swapPairs(Float a) { return {_mm_shuffle_ps(a.v, a.v, 0xB1)}; }
+
+#elif defined(SIMPLEUV_SIMD_NEON)
+
+const int kWidth = 4;
+struct Float { float32x4_t v; };
+struct Mask { uint32x4_t v; };
+
+inline Float load(const float *p) { return {vld1q_f32(p)}; }
+inline void store(float *p, Float a) { vst1q_f32(p, a.v); }
+inline Float broadcast(float x) { return {vdupq_n_f32(x)}; }
+inline Float operator+(Float a, Float b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {vmulq_f32(a.v, b.v)}; }
+#if defined(__aarch64__)
+inline Float operator/(Float a, Float b) { return {vdivq_f32(a.v, b.v)}; }
+inline Float sqrt(Float a) { return {vsqrtq_f32(a.v)}; }
+#else
+inline Float operator/(Float a, Float b)
+{
+    float32x4_t r = vrecpeq_f32(b.v);
+    r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+    r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+    return {vmulq_f32(a.v, r)};
+}
+inline Float sqrt(Float a)
+{
+    float lanes[4];
+    vst1q_f32(lanes, a.v);
+    for (int i = 0; i < 4; ++i)
+        lanes[i] = std::sqrt(lanes[i]);
+    return {vld1q_f32(lanes)};
+}
+#endif
+inline Float min(Float a, Float b) { return {vminq_f32(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {vmaxq_f32(a.v, b.v)}; }
+inline Float abs(Float a) { return {vabsq_f32(a.v)}; }
+inline Float mulAdd(Float a, Float b, Float c) { return {vmlaq_f32(c.v, a.v, b.v)}; }
+inline Mask lessThan(Float a, Float b) { return {vcltq_f32(a.v, b.v)}; }
+inline Mask lessEqual(Float a, Float b) { return {vcleq_f32(a.v, b.v)}; }
+inline Mask greaterEqual(Float a, Float b) { return {vcgeq_f32(a.v, b.v)}; }
+inline Mask equal(Float a, Float b) { return {vceqq_f32(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return {vandq_u32(a.v, b.v)}; }
+inline Mask operator|(Mask a, Mask b) { return {vorrq_u32(a.v, b.v)}; }
+inline Float select(Mask m, Float a, Float b) { return {vbslq_f32(m.v, a.v, b.v)}; }
+inline int bits(Mask m)
+{
+    uint32_t lanes[4];
+    vst1q_u32(lanes, m.v);
+    return (lanes[0] & 1) | ((lanes[1] & 1) << 1) | ((lanes[2] & 1) << 2) | ((lanes[3] & 1) << 3);
+}
+inline Float swapPairs(Float a) { return {vrev64q_f32(a.v)}; }
+
+#else
+
+const int kWidth = 1;
+struct Float { float v; };
+struct Mask { bool v; };
+
+inline Float load(const float *p) { return {*p}; }
+inline void store(float *p, Float a) { *p = a.v; }
+inline Float broadcast(float x) { return {x}; }
+inline Float operator+(Float a, Float b) { return {a.v + b.v}; }
+inline Float operator-(Float a, Float b) { return {a.v - b.v}; }
+inline Float operator*(Float a, Float b) { return {a.v * b.v}; }
+inline Float operator/(Float a, Float b) { return {a.v / b.v}; }
+inline Float min(Float a, Float b) { return {b.v < a.v ? b.v : a.v}; }
+inline Float max(Float a, Float b) { return {b.v > a.v ? b.v : a.v}; }
+inline Float sqrt(Float a) { return {std::sqrt(a.v)}; }
+inline Float abs(Float a) { return {std::fabs(a.v)}; }
+inline Float mulAdd(Float a, Float b, Float c) { return {a.v * b.v + c.v}; }
+inline Mask lessThan(Float a, Float b) { return {a.v < b.v}; }
+inline Mask lessEqual(Float a, Float b) { return {a.v <= b.v}; }
+inline Mask greaterEqual(Float a, Float b) { return {a.v >= b.v}; }
+inline Mask equal(Float a, Float b) { return {a.v == b.v}; }
+inline Mask operator&(Mask a, Mask b) { return {a.v && b.v}; }
+inline Mask operator|(Mask a, Mask b) { return {a.v || b.v}; }
+inline Float select(Mask m, Float a, Float b) { return m.v ? a : b; }
+inline int bits(Mask m) { return m.v ? 1 : 0; }
+
+#endif
+
+// Lanes holding NaN or Inf give false, because x - x is NaN for them
+inline Mask isFinite(Float a)
+{
+    Float d = a - a;
+    return equal(d, d);
+}
+
+inline int allBits()
+{
+    return (1 << kWidth) - 1;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <simpleuv/skylinepacker.h>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace simpleuv
+{
+
+struct SkylineSegment
+{
+    int left;
+    int top;
+    int width;
+};
+
+// Returns the lowest top where a rect of the given width can rest starting at segment index, or -1
+static int skylineFit(const std::vector<SkylineSegment> &skyline, size_t index, int width, int binWidth)
+{
+    int left = skyline[index].left;
+    if (left + width > binWidth)
+        return -1;
+    int top = 0;
+    int remainingWidth = width;
+    for (size_t i = index; remainingWidth > 0; ++i) {
+        if (i >= skyline.size())
+            return -1;
+        top = std::max(top, skyline[i].top);
+        remainingWidth -= skyline[i].width;
+    }
+    return top;
+}
+
+static void skylineAdd(std::vector<SkylineSegment> &skyline, size_t index, int left, int top, int width)
+{
+    skyline.insert(skyline.begin() + index, {left, top, width});
+    int right = left + width;
+    size_t next = index + 1;
+    while (next < skyline.size() && skyline[next].left < right) {
+        int shrink = right - skyline[next].left;
+        if (shrink >= skyline[next].width) {
+            skyline.erase(skyline.begin() + next);
+            continue;
+        }
+        skyline[next].left += shrink;
+        skyline[next].width -= shrink;
+        break;
+    }
+    for (size_t i = (index > 0 ? index - 1 : 0); i + 1 < skyline.size() && i <= index + 1; ) {
+        if (skyline[i].top == skyline[i + 1].top) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+            continue;
+        }
+        ++i;
+    }
+}
+
+bool skylinePack(int width, int height, const std::vector<std::pair<int, int>> &rects, bool allowRotations,
+    std::vector<std::tuple<int, int, bool>> &result, float *occupancy,
+    std::vector<size_t> *unfittedRects)
+{
+    // Lay every rect flat when it still fits the bin width, then place the tallest first
+    std::vector<std::pair<int, int>> orientedRects(rects);
+    std::vector<bool> rotations(rects.size(), false);
+    for (size_t i = 0; i < rects.size(); ++i) {
+        auto &rect = orientedRects[i];
+        if (allowRotations && rect.second > rect.first && rect.second <= width) {
+            std::swap(rect.first, rect.second);
+            rotations[i] = true;
+        }
+    }
+    std::vector<size_t> order(rects.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t first, size_t second) {
+        if (orientedRects[first].second != orientedRects[second].second)
+            return orientedRects[first].second > orientedRects[second].second;
+        return orientedRects[first].first > orientedRects[second].first;
+    });
+
+    std::vector<SkylineSegment> skyline = {{0, 0, width}};
+    result.resize(rects.size());
+    unsigned long long usedArea = 0;
+    for (const auto &rectIndex: order) {
+        int bestTop = std::numeric_limits<int>::max();
+        int bestBottom = std::numeric_limits<int>::max();
+        int bestLeft = 0;
+        size_t bestIndex = 0;
+        bool bestFlip = false;
+        for (size_t flip = 0; flip < (allowRotations ? 2u : 1u); ++flip) {
+            int rectWidth = flip ? orientedRects[rectIndex].second : orientedRects[rectIndex].first;
+            int rectHeight = flip ? orientedRects[rectIndex].first : orientedRects[rectIndex].second;
+            for (size_t i = 0; i < skyline.size(); ++i) {
+                int top = skylineFit(skyline, i, rectWidth, width);
+                if (top < 0 || top + rectHeight > height)
+                    continue;
+                int bottom = top + rectHeight;
+                if (bottom < bestBottom || (bottom == bestBottom && skyline[i].left < bestLeft)) {
+                    bestBottom = bottom;
+                    bestTop = top;
+                    bestLeft = skyline[i].left;
+                    bestIndex = i;
+                    bestFlip = 0 != flip;
+                }
+            }
+        }
+        if (std::numeric_limits<int>::max() == bestBottom) {
+            if (!unfittedRects)
+                return false;
+            unfittedRects->push_back(rectIndex);
+            continue;
+        }
+        const auto &rect = orientedRects[rectIndex];
+        int placedWidth = bestFlip ? rect.second : rect.first;
+        skylineAdd(skyline, bestIndex, bestLeft, bestBottom, placedWidth);
+        result[rectIndex] = std::make_tuple(bestLeft, bestTop, rotations[rectIndex] != bestFlip);
+        usedArea += (unsigned long long)rect.first * rect.second;
+    }
+    if (occupancy)
+        *occupancy = (float)((double)usedArea / ((double)width * height));
+    return true;
+}
+
+}
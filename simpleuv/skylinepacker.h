@@ -0,0 +1,23 @@
+#ifndef SIMPLEUV_SKYLINE_PACKER_H
+#define SIMPLEUV_SKYLINE_PACKER_H
+#include <vector>
+#include <cstdlib>
+#include <tuple>
+
+namespace simpleuv
+{
+
+// Skyline bottom left packing, the rects are sorted by height once and placed in that order.
+// Each rect is tried at every skyline segment, so placing n rects takes O(n * S) for a skyline of S segments,
+// at worst O(n^2). Segments of the same height merge and S stays far below n in practice, which is what lets it
+// scale to tens of thousands of charts where the free rectangle search of MaxRects doesn't.
+// The result is left, top and rotated for each rect in the input order.
+// Without unfittedRects it fails as soon as one rect doesn't fit, with it the rects that don't fit
+// are listed there and the bin is filled as much as possible
+bool skylinePack(int width, int height, const std::vector<std::pair<int, int>> &rects, bool allowRotations,
+    std::vector<std::tuple<int, int, bool>> &result, float *occupancy=nullptr,
+    std::vector<size_t> *unfittedRects=nullptr);
+
+}
+
+#endif
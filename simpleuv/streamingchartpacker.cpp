@@ -0,0 +1,246 @@
+#include <simpleuv/streamingchartpacker.h>
+#include <simpleuv/chartpacker.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace simpleuv
+{
+
+// Only a minimal occupancy bounds the final size, without it placing again gives up after this many passes
+const size_t kMaxReplacePassNum = 3;
+
+void StreamingChartPacker::setMinOccupancy(float minOccupancy)
+{
+    m_minOccupancy = minOccupancy;
+}
+
+void StreamingChartPacker::setExpectedFaceNum(size_t expectedFaceNum)
+{
+    m_expectedFaceNum = expectedFaceNum;
+}
+
+float StreamingChartPacker::getOccupancy() const
+{
+    return m_occupancy;
+}
+
+const std::vector<std::tuple<float, float, float, float, bool>> &StreamingChartPacker::getResult()
+{
+    return m_result;
+}
+
+bool StreamingChartPacker::findPosition(float width, float height, Box &box, bool &rotated)
+{
+    // Best short side fit over the maximal free boxes, same as the first heuristic of ChartPacker
+    float bestShortSideFit = std::numeric_limits<float>::max();
+    float bestLongSideFit = std::numeric_limits<float>::max();
+    bool found = false;
+    for (const auto &freeBox: m_freeBoxes) {
+        for (size_t flip = 0; flip < 2; ++flip) {
+            float boxWidth = flip ? height : width;
+            float boxHeight = flip ? width : height;
+            if (freeBox.width < boxWidth || freeBox.height < boxHeight)
+                continue;
+            float leftoverHoriz = freeBox.width - boxWidth;
+            float leftoverVert = freeBox.height - boxHeight;
+            float shortSideFit = std::min(leftoverHoriz, leftoverVert);
+            float longSideFit = std::max(leftoverHoriz, leftoverVert);
+            if (shortSideFit < bestShortSideFit ||
+                    (shortSideFit == bestShortSideFit && longSideFit < bestLongSideFit)) {
+                bestShortSideFit = shortSideFit;
+                bestLongSideFit = longSideFit;
+                box = {freeBox.left, freeBox.top, boxWidth, boxHeight};
+                rotated = 0 != flip;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void StreamingChartPacker::placeBox(const Box &box)
+{
+    // Only the boxes the placement cuts into are split, the others stay maximal
+    std::vector<Box> splitBoxes;
+    size_t keptNum = 0;
+    for (size_t i = 0; i < m_freeBoxes.size(); ++i) {
+        const Box freeBox = m_freeBoxes[i];
+        if (box.left >= freeBox.left + freeBox.width || box.left + box.width <= freeBox.left ||
+                box.top >= freeBox.top + freeBox.height || box.top + box.height <= freeBox.top) {
+            m_freeBoxes[keptNum++] = freeBox;
+            continue;
+        }
+        if (box.top > freeBox.top)
+            splitBoxes.push_back({freeBox.left, freeBox.top, freeBox.width, box.top - freeBox.top});
+        if (box.top + box.height < freeBox.top + freeBox.height)
+            splitBoxes.push_back({freeBox.left, box.top + box.height, freeBox.width, freeBox.top + freeBox.height - (box.top + box.height)});
+        if (box.left > freeBox.left)
+            splitBoxes.push_back({freeBox.left, freeBox.top, box.left - freeBox.left, freeBox.height});
+        if (box.left + box.width < freeBox.left + freeBox.width)
+            splitBoxes.push_back({box.left + box.width, freeBox.top, freeBox.left + freeBox.width - (box.left + box.width), freeBox.height});
+    }
+    m_freeBoxes.resize(keptNum);
+    m_freeBoxes.insert(m_freeBoxes.end(), splitBoxes.begin(), splitBoxes.end());
+    pruneFreeBoxes(keptNum);
+}
+
+void StreamingChartPacker::pruneFreeBoxes(size_t firstNewBox)
+{
+    auto isContainedIn = [](const Box &a, const Box &b) {
+        return a.left >= b.left && a.top >= b.top &&
+            a.left + a.width <= b.left + b.width &&
+            a.top + a.height <= b.top + b.height;
+    };
+    // A new box can't contain an old one, that one would have been inside the box the new one was split from
+    std::vector<bool> removed(m_freeBoxes.size() - firstNewBox, false);
+    for (size_t i = firstNewBox; i < m_freeBoxes.size(); ++i) {
+        for (size_t j = 0; j < m_freeBoxes.size(); ++j) {
+            if (j == i || (j >= firstNewBox && removed[j - firstNewBox]))
+                continue;
+            if (!isContainedIn(m_freeBoxes[i], m_freeBoxes[j]))
+                continue;
+            // Of two equal new boxes the later one goes
+            if (j < firstNewBox || j < i || !isContainedIn(m_freeBoxes[j], m_freeBoxes[i])) {
+                removed[i - firstNewBox] = true;
+                break;
+            }
+        }
+    }
+    size_t keptNum = firstNewBox;
+    for (size_t i = firstNewBox; i < m_freeBoxes.size(); ++i) {
+        if (!removed[i - firstNewBox])
+            m_freeBoxes[keptNum++] = m_freeBoxes[i];
+    }
+    m_freeBoxes.resize(keptNum);
+}
+
+void StreamingChartPacker::grow(float width, float height)
+{
+    // Extend the shorter side, the free boxes touching that side are maximal so they simply get longer
+    if (m_width <= m_height) {
+        float newWidth = m_width + std::max(std::min(width, height), m_width * m_atlasGrowFactor);
+        for (auto &freeBox: m_freeBoxes) {
+            if (freeBox.left + freeBox.width >= m_width)
+                freeBox.width = newWidth - freeBox.left;
+        }
+        m_freeBoxes.push_back({m_width, 0, newWidth - m_width, m_height});
+        m_width = newWidth;
+    } else {
+        float newHeight = m_height + std::max(std::min(width, height), m_height * m_atlasGrowFactor);
+        for (auto &freeBox: m_freeBoxes) {
+            if (freeBox.top + freeBox.height >= m_height)
+                freeBox.height = newHeight - freeBox.top;
+        }
+        m_freeBoxes.push_back({0, m_height, m_width, newHeight - m_height});
+        m_height = newHeight;
+    }
+    pruneFreeBoxes(m_freeBoxes.size() - 1);
+}
+
+size_t StreamingChartPacker::addChart(const std::pair<float, float> &chartSize, size_t faceNum)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t chartIndex = m_chartSizes.size();
+    m_chartSizes.push_back(chartSize);
+    m_chartBoxes.push_back({0, 0, 0, 0});
+    m_chartRotations.push_back(false);
+    m_chartPaddingSizes.push_back(0);
+    m_usedArea += (double)chartSize.first * chartSize.second;
+    m_addedFaceNum += faceNum;
+
+    // A layout finish() keeps is at least m_minOccupancy full, so its texture is no larger than this
+    double projectedArea = m_usedArea;
+    if (m_expectedFaceNum > m_addedFaceNum && m_addedFaceNum > 0)
+        projectedArea *= (double)m_expectedFaceNum / m_addedFaceNum;
+    float projectedSize = m_minOccupancy > 0 ? (float)std::sqrt(projectedArea / m_minOccupancy) : 0;
+    float paddingSize = m_paddingSize * std::max(std::max(m_width, m_height),
+        std::max(projectedSize, std::max(chartSize.first, chartSize.second)));
+    placeChart(chartIndex, paddingSize);
+    return chartIndex;
+}
+
+void StreamingChartPacker::placeChart(size_t chartIndex, float paddingSize)
+{
+    const auto &chartSize = m_chartSizes[chartIndex];
+    float paddingSize2 = paddingSize + paddingSize;
+    float width = chartSize.first + paddingSize2;
+    float height = chartSize.second + paddingSize2;
+    if (0 == m_width || 0 == m_height) {
+        m_width = m_height = std::max(width, height);
+        m_freeBoxes.push_back({0, 0, m_width, m_height});
+    }
+    Box box;
+    bool rotated = false;
+    while (!findPosition(width, height, box, rotated))
+        grow(width, height);
+    placeBox(box);
+    m_chartBoxes[chartIndex] = {box.left + paddingSize, box.top + paddingSize, chartSize.first, chartSize.second};
+    m_chartRotations[chartIndex] = rotated;
+    m_chartPaddingSizes[chartIndex] = paddingSize;
+}
+
+float StreamingChartPacker::calculateUsedSize() const
+{
+    // The atlas grows in steps, the last strips are often only partly used
+    float usedSize = 0;
+    for (size_t i = 0; i < m_chartBoxes.size(); ++i) {
+        const auto &box = m_chartBoxes[i];
+        float width = m_chartRotations[i] ? box.height : box.width;
+        float height = m_chartRotations[i] ? box.width : box.height;
+        usedSize = std::max(usedSize, std::max(box.left + width, box.top + height) + m_chartPaddingSizes[i]);
+    }
+    return usedSize;
+}
+
+float StreamingChartPacker::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    float textureSize = calculateUsedSize();
+    auto calculateOccupancy = [&]() {
+        return textureSize > 0 ? (float)(m_usedArea / ((double)textureSize * textureSize)) : 0;
+    };
+
+    // Charts padded for less than the final size take a new place with the padding of the largest texture the layout
+    // can be kept at, their old places stay empty. Placing them can grow the atlas a little, and so the padding
+    // the others need, so it may take another pass. Allow for the rounding of the sizes the padding was taken from
+    float keptPaddingSize = m_minOccupancy > 0 ? m_paddingSize * (float)std::sqrt(m_usedArea / m_minOccupancy) : 0;
+    bool paddingSettled = false;
+    for (size_t pass = 0; pass <= kMaxReplacePassNum && calculateOccupancy() >= m_minOccupancy; ++pass) {
+        float neededPaddingSize = m_paddingSize * textureSize;
+        std::vector<size_t> underPaddedCharts;
+        for (size_t i = 0; i < m_chartPaddingSizes.size(); ++i) {
+            if (m_chartPaddingSizes[i] < neededPaddingSize * 0.999f)
+                underPaddedCharts.push_back(i);
+        }
+        if (underPaddedCharts.empty()) {
+            paddingSettled = true;
+            break;
+        }
+        if (pass == kMaxReplacePassNum)
+            break;
+        //qDebug() << "Streaming pack places" << underPaddedCharts.size() << "under padded charts again";
+        for (const auto &chartIndex: underPaddedCharts)
+            placeChart(chartIndex, std::max(neededPaddingSize, keptPaddingSize));
+        textureSize = calculateUsedSize();
+    }
+    m_occupancy = calculateOccupancy();
+    if (!paddingSettled && !m_chartSizes.empty()) {
+        //qDebug() << "Streaming pack occupancy:" << m_occupancy << "too low or padding unsettled, repack";
+        ChartPacker chartPacker;
+        chartPacker.setCharts(m_chartSizes);
+        textureSize = chartPacker.pack();
+        m_result = chartPacker.getResult();
+        m_occupancy = calculateOccupancy();
+        return textureSize;
+    }
+    m_result.resize(m_chartBoxes.size());
+    for (size_t i = 0; i < m_chartBoxes.size(); ++i) {
+        const auto &box = m_chartBoxes[i];
+        m_result[i] = std::make_tuple(box.left / textureSize, box.top / textureSize,
+            box.width / textureSize, box.height / textureSize, (bool)m_chartRotations[i]);
+    }
+    return textureSize;
+}
+
+}
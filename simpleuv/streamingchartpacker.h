@@ -0,0 +1,65 @@
+#ifndef SIMPLEUV_STREAMING_CHART_PACKER_H
+#define SIMPLEUV_STREAMING_CHART_PACKER_H
+#include <vector>
+#include <tuple>
+#include <mutex>
+
+namespace simpleuv
+{
+
+// Places every chart into a growing atlas as soon as it's added, so packing runs while the other
+// islands are still being parametrized. The padding is a fraction of the final texture size, which isn't known yet,
+// so each chart is padded for the largest texture the layout can end up with and still be kept: the projected chart
+// area at the minimal occupancy. finish() keeps that layout and only places again the charts the projection
+// under padded, or re-packs everything with ChartPacker when the atlas ended up emptier than the minimal occupancy.
+class StreamingChartPacker
+{
+public:
+    void setMinOccupancy(float minOccupancy);
+    // Faces of all the charts that are going to be added, the chart area to come is projected from the faces added so far.
+    // Without it the padding follows the charts added so far, and more charts have to be placed again in finish()
+    void setExpectedFaceNum(size_t expectedFaceNum);
+    // Safe to call from several threads, returns the index of the chart in getResult()
+    size_t addChart(const std::pair<float, float> &chartSize, size_t faceNum=0);
+    float finish();
+    float getOccupancy() const;
+    const std::vector<std::tuple<float, float, float, float, bool>> &getResult();
+
+private:
+    struct Box
+    {
+        float left;
+        float top;
+        float width;
+        float height;
+    };
+
+    void placeChart(size_t chartIndex, float paddingSize);
+    bool findPosition(float width, float height, Box &box, bool &rotated);
+    void placeBox(const Box &box);
+    void grow(float width, float height);
+    float calculateUsedSize() const;
+    // The boxes before firstNewBox are maximal among themselves, only the ones after are checked
+    void pruneFreeBoxes(size_t firstNewBox);
+
+    std::mutex m_mutex;
+    std::vector<std::pair<float, float>> m_chartSizes;
+    std::vector<Box> m_chartBoxes;
+    std::vector<bool> m_chartRotations;
+    std::vector<float> m_chartPaddingSizes;
+    std::vector<Box> m_freeBoxes;
+    std::vector<std::tuple<float, float, float, float, bool>> m_result;
+    float m_width = 0;
+    float m_height = 0;
+    double m_usedArea = 0;
+    size_t m_expectedFaceNum = 0;
+    size_t m_addedFaceNum = 0;
+    float m_occupancy = 0;
+    float m_minOccupancy = 0.5;
+    float m_atlasGrowFactor = 0.25;
+    float m_paddingSize = 0.002;
+};
+
+}
+
+#endif
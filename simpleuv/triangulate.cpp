@@ -49,7 +49,8 @@ static bool pointInTriangle(const Eigen::Vector3d &a, const Eigen::Vector3d &b,
     return r + t <= 1.0;
 }
 
-static Eigen::Vector3d ringNorm(const std::vector<Vertex> &vertices, const std::vector<size_t> &ring)
+template <class IndexType>
+static Eigen::Vector3d ringNorm(const std::vector<Vertex> &vertices, const std::vector<IndexType> &ring)
 {
     Eigen::Vector3d normal(0.0, 0.0, 0.0);
     for (size_t i = 0; i < ring.size(); ++i) {
@@ -63,11 +64,12 @@ static Eigen::Vector3d ringNorm(const std::vector<Vertex> &vertices, const std::
     return normal.normalized();
 }
 
-void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces, const std::vector<size_t> &ring)
+template <class FaceType, class IndexType>
+static void triangulateImpl(const std::vector<Vertex> &vertices, std::vector<FaceType> &faces, const std::vector<IndexType> &ring)
 {
     if (ring.size() < 3)
         return;
-    std::vector<size_t> fillRing = ring;
+    std::vector<IndexType> fillRing = ring;
     Eigen::Vector3d direct = ringNorm(vertices, fillRing);
     while (fillRing.size() > 3) {
         bool newFaceGenerated = false;
@@ -89,7 +91,7 @@ void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces,
                     }
                 }
                 if (isEar) {
-                    Face newFace;
+                    FaceType newFace;
                     newFace.indices[0] = fillRing[i];
                     newFace.indices[1] = fillRing[j];
                     newFace.indices[2] = fillRing[k];
@@ -104,7 +106,7 @@ void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces,
             break;
     }
     if (fillRing.size() == 3) {
-        Face newFace;
+        FaceType newFace;
         newFace.indices[0] = fillRing[0];
         newFace.indices[1] = fillRing[1];
         newFace.indices[2] = fillRing[2];
@@ -112,4 +114,14 @@ void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces,
     }
 }
 
+void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces, const std::vector<size_t> &ring)
+{
+    triangulateImpl(vertices, faces, ring);
+}
+
+void triangulate(const std::vector<Vertex> &vertices, std::vector<CompactFace> &faces, const std::vector<Index> &ring)
+{
+    triangulateImpl(vertices, faces, ring);
+}
+
 }
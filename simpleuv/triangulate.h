@@ -6,6 +6,7 @@ namespace simpleuv
 {
 
 void triangulate(const std::vector<Vertex> &vertices, std::vector<Face> &faces, const std::vector<size_t> &ring);
+void triangulate(const std::vector<Vertex> &vertices, std::vector<CompactFace> &faces, const std::vector<Index> &ring);
 
 }
 
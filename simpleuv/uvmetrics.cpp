@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+#include <simpleuv/uvmetrics.h>
+#include <simpleuv/uvunwrapper.h>
+#include <simpleuv/simd.h>
+#include <simpleuv/parallelfor.h>
+
+namespace simpleuv
+{
+
+static const size_t kBlockSize = 256;
+
+struct FaceStretch
+{
+    std::vector<float> signedUvAreas;
+    std::vector<float> surfaceAreas;
+    std::vector<float> l2Stretches;
+    std::vector<float> lInfStretches;
+    std::vector<float> conformalErrors;
+};
+
+// The faces are gathered in blocks into SoA arrays of the surface edges and the uv edges,
+// the Jacobian of the uv to surface map and its singular values are then computed on full vectors
+static void calculateFaceStretches(const Mesh &mesh, const std::vector<FaceTextureCoords> &faceUvs,
+    const Index *faces, size_t faceNum, FaceStretch &stretch, size_t offset)
+{
+    float edges[10][kBlockSize];
+    float results[5][kBlockSize];
+    const simd::Float zero = simd::broadcast(0.0f);
+    const simd::Float half = simd::broadcast(0.5f);
+    const simd::Float four = simd::broadcast(4.0f);
+    for (size_t begin = 0; begin < faceNum; begin += kBlockSize) {
+        size_t count = std::min(kBlockSize, faceNum - begin);
+        size_t paddedCount = (count + simd::kWidth - 1) / simd::kWidth * simd::kWidth;
+        for (size_t i = 0; i < count; ++i) {
+            Index faceIndex = faces[begin + i];
+            const auto &face = mesh.faces[faceIndex];
+            const auto &uv = faceUvs[faceIndex];
+            const float *q0 = mesh.vertices[face.indices[0]].xyz;
+            const float *q1 = mesh.vertices[face.indices[1]].xyz;
+            const float *q2 = mesh.vertices[face.indices[2]].xyz;
+            for (size_t k = 0; k < 3; ++k) {
+                edges[k][i] = q1[k] - q0[k];
+                edges[3 + k][i] = q2[k] - q0[k];
+            }
+            edges[6][i] = uv.coords[1].uv[0] - uv.coords[0].uv[0];
+            edges[7][i] = uv.coords[1].uv[1] - uv.coords[0].uv[1];
+            edges[8][i] = uv.coords[2].uv[0] - uv.coords[0].uv[0];
+            edges[9][i] = uv.coords[2].uv[1] - uv.coords[0].uv[1];
+        }
+        for (size_t i = count; i < paddedCount; ++i) {
+            for (size_t k = 0; k < 10; ++k)
+                edges[k][i] = 0;
+        }
+        for (size_t i = 0; i < paddedCount; i += simd::kWidth) {
+            simd::Float e1[3], e2[3];
+            for (size_t k = 0; k < 3; ++k) {
+                e1[k] = simd::load(&edges[k][i]);
+                e2[k] = simd::load(&edges[3 + k][i]);
+            }
+            simd::Float du1 = simd::load(&edges[6][i]);
+            simd::Float dv1 = simd::load(&edges[7][i]);
+            simd::Float du2 = simd::load(&edges[8][i]);
+            simd::Float dv2 = simd::load(&edges[9][i]);
+            simd::Float doubleUvArea = du1 * dv2 - du2 * dv1;
+            simd::Mask valid = simd::lessThan(zero, simd::abs(doubleUvArea));
+            simd::Float inverse = simd::select(valid, simd::broadcast(1.0f) / doubleUvArea, zero);
+            // Partial derivatives of the surface position along u and along v
+            simd::Float a = zero, b = zero, c = zero;
+            for (size_t k = 0; k < 3; ++k) {
+                simd::Float ss = (e1[k] * dv2 - e2[k] * dv1) * inverse;
+                simd::Float st = (e2[k] * du1 - e1[k] * du2) * inverse;
+                a = simd::mulAdd(ss, ss, a);
+                b = simd::mulAdd(ss, st, b);
+                c = simd::mulAdd(st, st, c);
+            }
+            simd::Float nx = e1[1] * e2[2] - e1[2] * e2[1];
+            simd::Float ny = e1[2] * e2[0] - e1[0] * e2[2];
+            simd::Float nz = e1[0] * e2[1] - e1[1] * e2[0];
+            simd::Float surfaceArea = simd::sqrt(simd::mulAdd(nx, nx, simd::mulAdd(ny, ny, nz * nz))) * half;
+            simd::Float sum = a + c;
+            simd::Float difference = a - c;
+            simd::Float discriminant = simd::sqrt(simd::mulAdd(difference, difference, four * b * b));
+            simd::Float largest = simd::sqrt((sum + discriminant) * half);
+            simd::Float smallest = simd::sqrt(simd::max(zero, (sum - discriminant) * half));
+            simd::Mask conformalValid = valid & simd::lessThan(zero, smallest);
+            simd::store(&results[0][i], doubleUvArea * half);
+            simd::store(&results[1][i], surfaceArea);
+            simd::store(&results[2][i], simd::select(valid, simd::sqrt(sum * half), zero));
+            simd::store(&results[3][i], simd::select(valid, largest, zero));
+            simd::store(&results[4][i], simd::select(conformalValid, largest / simd::select(conformalValid, smallest, simd::broadcast(1.0f)), zero));
+        }
+        std::copy(results[0], results[0] + count, stretch.signedUvAreas.begin() + offset + begin);
+        std::copy(results[1], results[1] + count, stretch.surfaceAreas.begin() + offset + begin);
+        std::copy(results[2], results[2] + count, stretch.l2Stretches.begin() + offset + begin);
+        std::copy(results[3], results[3] + count, stretch.lInfStretches.begin() + offset + begin);
+        std::copy(results[4], results[4] + count, stretch.conformalErrors.begin() + offset + begin);
+    }
+}
+
+void calculateUvMetrics(const Mesh &mesh, const std::vector<FaceTextureCoords> &faceUvs,
+    const std::vector<size_t> &chartOffsets, const std::vector<Index> &chartFaces,
+    UvMetrics &metrics, size_t threadNum)
+{
+    size_t chartNum = chartOffsets.empty() ? 0 : chartOffsets.size() - 1;
+    size_t chartFaceNum = chartOffsets.empty() ? 0 : chartOffsets.back();
+    metrics = UvMetrics();
+    metrics.faceL2Stretches.assign(mesh.faces.size(), 0);
+    metrics.faceLInfStretches.assign(mesh.faces.size(), 0);
+    metrics.faceConformalErrors.assign(mesh.faces.size(), 0);
+    metrics.charts.resize(chartNum);
+
+    // Raw stretch per chart face, in chart face order
+    FaceStretch stretch;
+    stretch.signedUvAreas.resize(chartFaceNum);
+    stretch.surfaceAreas.resize(chartFaceNum);
+    stretch.l2Stretches.resize(chartFaceNum);
+    stretch.lInfStretches.resize(chartFaceNum);
+    stretch.conformalErrors.resize(chartFaceNum);
+    size_t blockNum = (chartFaceNum + kBlockSize - 1) / kBlockSize;
+    parallelFor(blockNum, threadNum, [&](size_t blockBegin, size_t blockEnd) {
+        size_t begin = blockBegin * kBlockSize;
+        size_t end = std::min(chartFaceNum, blockEnd * kBlockSize);
+        if (begin < end)
+            calculateFaceStretches(mesh, faceUvs, chartFaces.data() + begin, end - begin, stretch, begin);
+    });
+
+    // Scale each chart to its surface area, then reduce
+    std::vector<double> chartSurfaceAreas(chartNum, 0);
+    parallelFor(chartNum, threadNum, [&](size_t chartBegin, size_t chartEnd) {
+        for (size_t chartIndex = chartBegin; chartIndex < chartEnd; ++chartIndex) {
+            size_t begin = chartOffsets[chartIndex];
+            size_t end = chartOffsets[chartIndex + 1];
+            double surfaceArea = 0;
+            double uvArea = 0;
+            double signedUvArea = 0;
+            for (size_t i = begin; i < end; ++i) {
+                surfaceArea += stretch.surfaceAreas[i];
+                uvArea += std::abs(stretch.signedUvAreas[i]);
+                signedUvArea += stretch.signedUvAreas[i];
+            }
+            float scale = surfaceArea > 0 ? (float)std::sqrt(uvArea / surfaceArea) : 0;
+            double weightedL2 = 0;
+            double weightedConformal = 0;
+            double weight = 0;
+            float lInfStretch = 0;
+            uint32_t flippedFaceNum = 0;
+            for (size_t i = begin; i < end; ++i) {
+                Index faceIndex = chartFaces[i];
+                float l2Stretch = stretch.l2Stretches[i] * scale;
+                float faceLInfStretch = stretch.lInfStretches[i] * scale;
+                metrics.faceL2Stretches[faceIndex] = l2Stretch;
+                metrics.faceLInfStretches[faceIndex] = faceLInfStretch;
+                metrics.faceConformalErrors[faceIndex] = stretch.conformalErrors[i];
+                if (stretch.signedUvAreas[i] * signedUvArea < 0)
+                    ++flippedFaceNum;
+                if (0 == stretch.l2Stretches[i] || !std::isfinite(l2Stretch))
+                    continue;
+                weightedL2 += (double)l2Stretch * l2Stretch * stretch.surfaceAreas[i];
+                weightedConformal += (double)stretch.conformalErrors[i] * stretch.surfaceAreas[i];
+                weight += stretch.surfaceAreas[i];
+                lInfStretch = std::max(lInfStretch, faceLInfStretch);
+            }
+            auto &chart = metrics.charts[chartIndex];
+            chart.l2Stretch = weight > 0 ? (float)std::sqrt(weightedL2 / weight) : 0;
+            chart.lInfStretch = lInfStretch;
+            chart.conformalError = weight > 0 ? (float)(weightedConformal / weight) : 0;
+            chart.texelDensity = scale;
+            chart.flippedFaceNum = flippedFaceNum;
+            chartSurfaceAreas[chartIndex] = surfaceArea;
+        }
+    });
+
+    double totalSurfaceArea = 0;
+    double weightedL2 = 0;
+    double weightedConformal = 0;
+    for (size_t chartIndex = 0; chartIndex < chartNum; ++chartIndex) {
+        const auto &chart = metrics.charts[chartIndex];
+        double surfaceArea = chartSurfaceAreas[chartIndex];
+        totalSurfaceArea += surfaceArea;
+        weightedL2 += (double)chart.l2Stretch * chart.l2Stretch * surfaceArea;
+        weightedConformal += (double)chart.conformalError * surfaceArea;
+        metrics.lInfStretch = std::max(metrics.lInfStretch, chart.lInfStretch);
+        metrics.flippedFaceNum += chart.flippedFaceNum;
+    }
+    if (totalSurfaceArea > 0) {
+        metrics.l2Stretch = (float)std::sqrt(weightedL2 / totalSurfaceArea);
+        metrics.conformalError = (float)(weightedConformal / totalSurfaceArea);
+    }
+    // Texel density over all the faces weighted by surface area, a uniform density has zero variance
+    double densitySum = 0;
+    double densitySquareSum = 0;
+    double densityWeight = 0;
+    for (size_t i = 0; i < chartFaceNum; ++i) {
+        double surfaceArea = stretch.surfaceAreas[i];
+        if (surfaceArea <= 0)
+            continue;
+        double density = std::sqrt(std::abs(stretch.signedUvAreas[i]) / surfaceArea);
+        densitySum += density * surfaceArea;
+        densitySquareSum += density * density * surfaceArea;
+        densityWeight += surfaceArea;
+    }
+    if (densityWeight > 0) {
+        double mean = densitySum / densityWeight;
+        metrics.texelDensityMean = (float)mean;
+        metrics.texelDensityVariance = (float)std::max(0.0, densitySquareSum / densityWeight - mean * mean);
+    }
+}
+
+void calculateUvMetrics(const Mesh &mesh, const UvUnwrapper &unwrapper, UvMetrics &metrics, size_t threadNum)
+{
+    calculateUvMetrics(mesh, unwrapper.getFaceUvs(), unwrapper.getChartOffsets(), unwrapper.getChartFaces(),
+        metrics, threadNum);
+}
+
+}
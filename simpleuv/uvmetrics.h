@@ -0,0 +1,49 @@
+#ifndef SIMPLEUV_UV_METRICS_H
+#define SIMPLEUV_UV_METRICS_H
+#include <vector>
+#include <cstdint>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+class UvUnwrapper;
+
+// Stretch is Sander's L2 and L-infinity stretch of the uv to surface map, measured after scaling each chart
+// to the same area as its surface, so 1 means no distortion whatever the packing scale.
+// Conformal error is the ratio of the larger to the smaller singular value, 1 means angle preserving.
+// Texel density is the square root of uv area over surface area, flipped faces are the ones whose uv winding
+// is against the rest of their chart
+struct ChartUvMetrics
+{
+    float l2Stretch;
+    float lInfStretch;
+    float conformalError;
+    float texelDensity;
+    uint32_t flippedFaceNum;
+};
+
+struct UvMetrics
+{
+    // Per face, faces outside any chart are 0
+    std::vector<float> faceL2Stretches;
+    std::vector<float> faceLInfStretches;
+    std::vector<float> faceConformalErrors;
+    std::vector<ChartUvMetrics> charts;
+    float l2Stretch = 0;
+    float lInfStretch = 0;
+    float conformalError = 0;
+    float texelDensityMean = 0;
+    float texelDensityVariance = 0;
+    size_t flippedFaceNum = 0;
+};
+
+// Chart i covers chartFaces[chartOffsets[i], chartOffsets[i + 1]), threadNum 0 means one thread per hardware thread
+void calculateUvMetrics(const Mesh &mesh, const std::vector<FaceTextureCoords> &faceUvs,
+    const std::vector<size_t> &chartOffsets, const std::vector<Index> &chartFaces,
+    UvMetrics &metrics, size_t threadNum=0);
+void calculateUvMetrics(const Mesh &mesh, const UvUnwrapper &unwrapper, UvMetrics &metrics, size_t threadNum=0);
+
+}
+
+#endif
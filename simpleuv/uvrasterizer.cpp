@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <simpleuv/uvrasterizer.h>
+#include <simpleuv/uvunwrapper.h>
+
+namespace simpleuv
+{
+
+// One tile row is exactly one coverage word, so the tiles never share a word and need no locking
+static const int kTileSize = 64;
+
+static void rasterizeTile(const std::vector<FaceTextureCoords> &faceUvs, const std::vector<int> &faceCharts,
+    const Index *tileFaces, size_t tileFaceNum, int tileX, int tileY, UvRaster &raster)
+{
+    int tileLeft = tileX * kTileSize;
+    int tileTop = tileY * kTileSize;
+    int tileRight = std::min(tileLeft + kTileSize, raster.width) - 1;
+    int tileBottom = std::min(tileTop + kTileSize, raster.height) - 1;
+    for (size_t n = 0; n < tileFaceNum; ++n) {
+        Index faceIndex = tileFaces[n];
+        const auto &faceUv = faceUvs[faceIndex];
+        double x[3], y[3];
+        for (size_t i = 0; i < 3; ++i) {
+            x[i] = (double)faceUv.coords[i].uv[0] * raster.width;
+            y[i] = (double)faceUv.coords[i].uv[1] * raster.height;
+        }
+        double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (0 == area || std::isnan(area))
+            continue;
+        // Edge i goes from corner i to corner i + 1, its function is the weight of the opposite corner times the area
+        double a[3], b[3], c[3];
+        double sign = area > 0 ? 1.0 : -1.0;
+        for (size_t i = 0; i < 3; ++i) {
+            size_t j = (i + 1) % 3;
+            a[i] = (y[i] - y[j]) * sign;
+            b[i] = (x[j] - x[i]) * sign;
+            c[i] = (x[i] * y[j] - x[j] * y[i]) * sign;
+        }
+        double inverseArea = 1.0 / std::abs(area);
+        int minY = std::max(tileTop, (int)std::floor(std::min(y[0], std::min(y[1], y[2])) - 0.5));
+        int maxY = std::min(tileBottom, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+        int minX = std::max(tileLeft, (int)std::floor(std::min(x[0], std::min(x[1], x[2])) - 0.5));
+        int maxX = std::min(tileRight, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+        for (int py = minY; py <= maxY; ++py) {
+            // Scanline, clip the row to the span where all three edge functions are non negative
+            double sampleY = py + 0.5;
+            double spanLeft = minX;
+            double spanRight = maxX;
+            for (size_t i = 0; i < 3; ++i) {
+                double rowValue = b[i] * sampleY + c[i];
+                if (a[i] > 0)
+                    spanLeft = std::max(spanLeft, -rowValue / a[i] - 0.5);
+                else if (a[i] < 0)
+                    spanRight = std::min(spanRight, -rowValue / a[i] - 0.5);
+                else if (rowValue < 0)
+                    spanRight = spanLeft - 1;
+            }
+            if (spanLeft > spanRight)
+                continue;
+            int spanBegin = std::max(minX, (int)std::floor(spanLeft));
+            int spanEnd = std::min(maxX, (int)std::ceil(spanRight));
+            size_t rowOffset = (size_t)py * raster.width;
+            uint64_t &coverageWord = raster.coverage[(size_t)py * raster.coverageWordNum + tileX];
+            for (int px = spanBegin; px <= spanEnd; ++px) {
+                double sampleX = px + 0.5;
+                double e0 = a[0] * sampleX + b[0] * sampleY + c[0];
+                double e1 = a[1] * sampleX + b[1] * sampleY + c[1];
+                double e2 = a[2] * sampleX + b[2] * sampleY + c[2];
+                if (e0 < 0 || e1 < 0 || e2 < 0)
+                    continue;
+                size_t texel = rowOffset + px;
+                raster.faceIds[texel] = faceIndex;
+                raster.chartIds[texel] = faceCharts[faceIndex];
+                raster.barycentrics[texel * 2] = (float)(e2 * inverseArea);
+                raster.barycentrics[texel * 2 + 1] = (float)(e0 * inverseArea);
+                coverageWord |= (uint64_t)1 << (px & 63);
+            }
+        }
+    }
+}
+
+void rasterizeUvs(const std::vector<FaceTextureCoords> &faceUvs, const std::vector<int> &faceCharts,
+    int width, int height, UvRaster &raster, size_t threadNum)
+{
+    raster.width = std::max(width, 0);
+    raster.height = std::max(height, 0);
+    size_t texelNum = (size_t)raster.width * raster.height;
+    raster.faceIds.assign(texelNum, (Index)-1);
+    raster.chartIds.assign(texelNum, -1);
+    raster.barycentrics.assign(texelNum * 2, 0);
+    raster.coverageWordNum = (raster.width + 63) / 64;
+    raster.coverage.assign((size_t)raster.coverageWordNum * raster.height, 0);
+    if (0 == texelNum)
+        return;
+
+    // Bin the faces into the tiles their bounding boxes touch, in face order, so the later face wins a
+    // shared texel the same way whatever thread renders the tile
+    int tileColumnNum = (raster.width + kTileSize - 1) / kTileSize;
+    int tileRowNum = (raster.height + kTileSize - 1) / kTileSize;
+    size_t tileNum = (size_t)tileColumnNum * tileRowNum;
+    size_t faceNum = std::min(faceUvs.size(), faceCharts.size());
+    std::vector<int> faceTileRanges(faceNum * 4, -1);
+    std::vector<size_t> tileOffsets(tileNum + 1, 0);
+    for (size_t faceIndex = 0; faceIndex < faceNum; ++faceIndex) {
+        if (faceCharts[faceIndex] < 0)
+            continue;
+        const auto &faceUv = faceUvs[faceIndex];
+        float minU = std::min(faceUv.coords[0].uv[0], std::min(faceUv.coords[1].uv[0], faceUv.coords[2].uv[0]));
+        float maxU = std::max(faceUv.coords[0].uv[0], std::max(faceUv.coords[1].uv[0], faceUv.coords[2].uv[0]));
+        float minV = std::min(faceUv.coords[0].uv[1], std::min(faceUv.coords[1].uv[1], faceUv.coords[2].uv[1]));
+        float maxV = std::max(faceUv.coords[0].uv[1], std::max(faceUv.coords[1].uv[1], faceUv.coords[2].uv[1]));
+        if (!(minU <= maxU && minV <= maxV))
+            continue;
+        int *range = &faceTileRanges[faceIndex * 4];
+        range[0] = std::max(0, (int)std::floor(minU * raster.width) / kTileSize);
+        range[1] = std::min(tileColumnNum - 1, (int)std::floor(maxU * raster.width) / kTileSize);
+        range[2] = std::max(0, (int)std::floor(minV * raster.height) / kTileSize);
+        range[3] = std::min(tileRowNum - 1, (int)std::floor(maxV * raster.height) / kTileSize);
+        for (int tileY = range[2]; tileY <= range[3]; ++tileY) {
+            for (int tileX = range[0]; tileX <= range[1]; ++tileX)
+                ++tileOffsets[(size_t)tileY * tileColumnNum + tileX + 1];
+        }
+    }
+    for (size_t i = 1; i < tileOffsets.size(); ++i)
+        tileOffsets[i] += tileOffsets[i - 1];
+    std::vector<Index> tileFaces(tileOffsets.back());
+    std::vector<size_t> positions(tileOffsets.begin(), tileOffsets.end() - 1);
+    for (size_t faceIndex = 0; faceIndex < faceNum; ++faceIndex) {
+        const int *range = &faceTileRanges[faceIndex * 4];
+        if (range[0] < 0)
+            continue;
+        for (int tileY = range[2]; tileY <= range[3]; ++tileY) {
+            for (int tileX = range[0]; tileX <= range[1]; ++tileX)
+                tileFaces[positions[(size_t)tileY * tileColumnNum + tileX]++] = (Index)faceIndex;
+        }
+    }
+
+    std::atomic<size_t> nextTile(0);
+    auto work = [&]() {
+        while (true) {
+            size_t tile = nextTile++;
+            if (tile >= tileNum)
+                break;
+            rasterizeTile(faceUvs, faceCharts, tileFaces.data() + tileOffsets[tile], tileOffsets[tile + 1] - tileOffsets[tile],
+                (int)(tile % tileColumnNum), (int)(tile / tileColumnNum), raster);
+        }
+    };
+    if (0 == threadNum)
+        threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+    threadNum = std::min(threadNum, tileNum);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadNum; ++i)
+        threads.push_back(std::thread(work));
+    work();
+    for (auto &thread: threads)
+        thread.join();
+}
+
+void rasterizeUvs(const UvUnwrapper &unwrapper, int width, int height, UvRaster &raster,
+    int page, size_t threadNum)
+{
+    const auto &faceUvs = unwrapper.getFaceUvs();
+    const auto &chartOffsets = unwrapper.getChartOffsets();
+    const auto &chartFaces = unwrapper.getChartFaces();
+    const auto &chartRects = unwrapper.getChartRects();
+    std::vector<int> faceCharts(faceUvs.size(), -1);
+    for (size_t chartIndex = 0; chartIndex + 1 < chartOffsets.size(); ++chartIndex) {
+        if (chartIndex < chartRects.size() && chartRects[chartIndex].page != page)
+            continue;
+        for (size_t i = chartOffsets[chartIndex]; i < chartOffsets[chartIndex + 1]; ++i)
+            faceCharts[chartFaces[i]] = (int)chartIndex;
+    }
+    rasterizeUvs(faceUvs, faceCharts, width, height, raster, threadNum);
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef SIMPLEUV_UV_RASTERIZER_H
+#define SIMPLEUV_UV_RASTERIZER_H
+#include <vector>
+#include <cstdint>
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+class UvUnwrapper;
+
+// Texel (x, y) samples the uv ((x + 0.5) / width, (y + 0.5) / height).
+// An empty texel has face id (Index)-1 and chart id -1, the barycentrics of a covered texel are the weights
+// of the face's second and third corners, the first one is 1 minus both.
+// The coverage bit of texel (x, y) is bit x % 64 of coverage[y * coverageWordNum + x / 64]
+struct UvRaster
+{
+    int width = 0;
+    int height = 0;
+    std::vector<Index> faceIds;
+    std::vector<int> chartIds;
+    std::vector<float> barycentrics;
+    int coverageWordNum = 0;
+    std::vector<uint64_t> coverage;
+
+    bool isCovered(int x, int y) const
+    {
+        return 0 != (coverage[(size_t)y * coverageWordNum + (x >> 6)] & ((uint64_t)1 << (x & 63)));
+    }
+};
+
+// Faces with a negative chart id are skipped, threadNum 0 means one thread per hardware thread
+void rasterizeUvs(const std::vector<FaceTextureCoords> &faceUvs, const std::vector<int> &faceCharts,
+    int width, int height, UvRaster &raster, size_t threadNum=0);
+// Rasterizes the unwrap result, with pages only the charts on the given page
+void rasterizeUvs(const UvUnwrapper &unwrapper, int width, int height, UvRaster &raster,
+    int page=0, size_t threadNum=0);
+
+}
+
+#endif
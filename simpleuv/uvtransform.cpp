@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <limits>
+#include <simpleuv/uvtransform.h>
+#include <simpleuv/simd.h>
+
+namespace simpleuv
+{
+
+// The uvs are handled as one flat interleaved float array, u sits in the even lanes and v in the odd lanes,
+// so x' = a * u + b * v + c becomes lanes * diagonal + swapPairs(lanes) * crossed + offset
+
+UvTransform identityUvTransform()
+{
+    return {{1, 0, 0, 0, 1, 0}};
+}
+
+UvTransform translationUvTransform(float x, float y)
+{
+    return {{1, 0, x, 0, 1, y}};
+}
+
+UvTransform multiplyUvTransforms(const UvTransform &first, const UvTransform &second)
+{
+    const float *a = first.m;
+    const float *b = second.m;
+    UvTransform result;
+    result.m[0] = (double)a[0] * b[0] + (double)a[1] * b[3];
+    result.m[1] = (double)a[0] * b[1] + (double)a[1] * b[4];
+    result.m[2] = (double)a[0] * b[2] + (double)a[1] * b[5] + a[2];
+    result.m[3] = (double)a[3] * b[0] + (double)a[4] * b[3];
+    result.m[4] = (double)a[3] * b[1] + (double)a[4] * b[4];
+    result.m[5] = (double)a[3] * b[2] + (double)a[4] * b[5] + a[5];
+    return result;
+}
+
+static inline void transformPoint(const float *source, const UvTransform &transform, float *target)
+{
+    float u = source[0];
+    float v = source[1];
+    target[0] = transform.m[0] * u + transform.m[1] * v + transform.m[2];
+    target[1] = transform.m[3] * u + transform.m[4] * v + transform.m[5];
+}
+
+#if !defined(SIMPLEUV_SIMD_SCALAR)
+static void makeLanePatterns(const UvTransform &transform, simd::Float &diagonal, simd::Float &crossed, simd::Float &offset)
+{
+    float diagonalLanes[simd::kWidth];
+    float crossedLanes[simd::kWidth];
+    float offsetLanes[simd::kWidth];
+    for (int i = 0; i < simd::kWidth; i += 2) {
+        diagonalLanes[i] = transform.m[0];
+        diagonalLanes[i + 1] = transform.m[4];
+        crossedLanes[i] = transform.m[1];
+        crossedLanes[i + 1] = transform.m[3];
+        offsetLanes[i] = transform.m[2];
+        offsetLanes[i + 1] = transform.m[5];
+    }
+    diagonal = simd::load(diagonalLanes);
+    crossed = simd::load(crossedLanes);
+    offset = simd::load(offsetLanes);
+}
+#endif
+
+void transformUvs(const FaceTextureCoords *source, size_t faceNum, const UvTransform &transform,
+    FaceTextureCoords *target)
+{
+    if (0 == faceNum)
+        return;
+    const float *sourceValues = source[0].coords[0].uv;
+    float *targetValues = target[0].coords[0].uv;
+    size_t valueNum = faceNum * 6;
+    size_t i = 0;
+#if !defined(SIMPLEUV_SIMD_SCALAR)
+    simd::Float diagonal, crossed, offset;
+    makeLanePatterns(transform, diagonal, crossed, offset);
+    for (; i + simd::kWidth <= valueNum; i += simd::kWidth) {
+        simd::Float lanes = simd::load(sourceValues + i);
+        simd::store(targetValues + i, simd::mulAdd(lanes, diagonal, simd::mulAdd(simd::swapPairs(lanes), crossed, offset)));
+    }
+#endif
+    for (; i < valueNum; i += 2)
+        transformPoint(sourceValues + i, transform, targetValues + i);
+}
+
+void calculateTransformedUvBoundingBox(const FaceTextureCoords *uvs, size_t faceNum, const UvTransform &transform,
+    float &left, float &top, float &right, float &bottom)
+{
+    if (0 == faceNum) {
+        left = top = right = bottom = 0;
+        return;
+    }
+    const float *values = uvs[0].coords[0].uv;
+    size_t valueNum = faceNum * 6;
+    left = top = std::numeric_limits<float>::max();
+    right = bottom = std::numeric_limits<float>::lowest();
+    size_t i = 0;
+#if !defined(SIMPLEUV_SIMD_SCALAR)
+    if (valueNum >= (size_t)simd::kWidth) {
+        simd::Float diagonal, crossed, offset;
+        makeLanePatterns(transform, diagonal, crossed, offset);
+        simd::Float minLanes = simd::broadcast(std::numeric_limits<float>::max());
+        simd::Float maxLanes = simd::broadcast(std::numeric_limits<float>::lowest());
+        for (; i + simd::kWidth <= valueNum; i += simd::kWidth) {
+            simd::Float lanes = simd::load(values + i);
+            simd::Float transformed = simd::mulAdd(lanes, diagonal, simd::mulAdd(simd::swapPairs(lanes), crossed, offset));
+            minLanes = simd::min(minLanes, transformed);
+            maxLanes = simd::max(maxLanes, transformed);
+        }
+        float minValues[simd::kWidth];
+        float maxValues[simd::kWidth];
+        simd::store(minValues, minLanes);
+        simd::store(maxValues, maxLanes);
+        for (int lane = 0; lane < simd::kWidth; lane += 2) {
+            left = std::min(left, minValues[lane]);
+            top = std::min(top, minValues[lane + 1]);
+            right = std::max(right, maxValues[lane]);
+            bottom = std::max(bottom, maxValues[lane + 1]);
+        }
+    }
+#endif
+    for (; i < valueNum; i += 2) {
+        float point[2];
+        transformPoint(values + i, transform, point);
+        left = std::min(left, point[0]);
+        top = std::min(top, point[1]);
+        right = std::max(right, point[0]);
+        bottom = std::max(bottom, point[1]);
+    }
+}
+
+}
@@ -0,0 +1,23 @@
+#ifndef SIMPLEUV_UV_TRANSFORM_H
+#define SIMPLEUV_UV_TRANSFORM_H
+#include <simpleuv/meshdatatype.h>
+
+namespace simpleuv
+{
+
+UvTransform identityUvTransform();
+UvTransform translationUvTransform(float x, float y);
+
+// The result applies second first, then first
+UvTransform multiplyUvTransforms(const UvTransform &first, const UvTransform &second);
+
+void transformUvs(const FaceTextureCoords *source, size_t faceNum, const UvTransform &transform,
+    FaceTextureCoords *target);
+
+// Bounding box of the uvs after transform, all zero when faceNum is zero
+void calculateTransformedUvBoundingBox(const FaceTextureCoords *uvs, size_t faceNum, const UvTransform &transform,
+    float &left, float &top, float &right, float &bottom);
+
+}
+
+#endif
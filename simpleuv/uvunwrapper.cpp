@@ -1,14 +1,32 @@
 #include <map>
 #include <unordered_set>
+#include <unordered_map>
 #include <set>
 #include <queue>
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <functional>
 #include <simpleuv/uvunwrapper.h>
 #include <simpleuv/parametrize.h>
 #include <simpleuv/chartpacker.h>
 #include <simpleuv/triangulate.h>
+#include <simpleuv/facenormals.h>
+#include <simpleuv/oppositefaces.h>
+#include <simpleuv/uvtransform.h>
+#include <simpleuv/workstealingpool.h>
+#include <simpleuv/rasterchartpacker.h>
+#include <simpleuv/graphpartitioner.h>
+#include <simpleuv/islandmerger.h>
+#include <simpleuv/congruentislands.h>
+#include <simpleuv/parallelfor.h>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include <igl/cut_to_disk.h>
+#include <igl/cut_mesh.h>
+#include <igl/is_edge_manifold.h>
+#include <igl/boundary_loop.h>
 
 namespace simpleuv 
 {
@@ -17,7 +35,25 @@ const std::vector<float> UvUnwrapper::m_rotateDegrees = {5, 15, 20, 25, 30, 35,
 
 void UvUnwrapper::setMesh(const Mesh &mesh)
 {
-    m_mesh = mesh;
+    m_mesh.vertices.clear();
+    m_mesh.faces.clear();
+    m_mesh.faceNormals.clear();
+    m_mesh.facePartitions.clear();
+    if (mesh.vertices.size() > (size_t)std::numeric_limits<Index>::max() ||
+            mesh.faces.size() > (size_t)std::numeric_limits<Index>::max()) {
+        //qDebug() << "Mesh too large for the index type, define SIMPLEUV_64BIT_INDEX";
+        return;
+    }
+    m_mesh.vertices = mesh.vertices;
+    m_mesh.faces.resize(mesh.faces.size());
+    for (decltype(mesh.faces.size()) i = 0; i < mesh.faces.size(); ++i) {
+        const auto &face = mesh.faces[i];
+        auto &compactFace = m_mesh.faces[i];
+        for (size_t j = 0; j < 3; ++j)
+            compactFace.indices[j] = (Index)face.indices[j];
+    }
+    m_mesh.faceNormals = mesh.faceNormals;
+    m_mesh.facePartitions = mesh.facePartitions;
 }
 
 void UvUnwrapper::setTexelSize(float texelSize)
@@ -25,6 +61,11 @@ void UvUnwrapper::setTexelSize(float texelSize)
     m_texelSizePerUnit = texelSize;
 }
 
+void UvUnwrapper::setSegmentPreferMorePieces(bool segmentPreferMorePieces)
+{
+    m_segmentPreferMorePieces = segmentPreferMorePieces;
+}
+
 const std::vector<FaceTextureCoords> &UvUnwrapper::getFaceUvs() const
 {
     return m_faceUvs;
@@ -40,23 +81,31 @@ const std::vector<int> &UvUnwrapper::getChartSourcePartitions() const
     return m_chartSourcePartitions;
 }
 
-void UvUnwrapper::buildEdgeToFaceMap(const std::vector<Face> &faces, std::map<std::pair<size_t, size_t>, size_t> &edgeToFaceMap)
+const std::vector<UvTransform> &UvUnwrapper::getChartTransforms() const
 {
-    edgeToFaceMap.clear();
-    for (decltype(faces.size()) index = 0; index < faces.size(); ++index) {
-        const auto &face = faces[index];
-        for (size_t i = 0; i < 3; i++) {
-            size_t j = (i + 1) % 3;
-            edgeToFaceMap[{face.indices[i], face.indices[j]}] = index;
-        }
-    }
+    return m_chartTransforms;
+}
+
+const std::vector<size_t> &UvUnwrapper::getChartOffsets() const
+{
+    return m_chartOffsets;
+}
+
+const std::vector<Index> &UvUnwrapper::getChartFaces() const
+{
+    return m_chartFaces;
+}
+
+const std::vector<FaceTextureCoords> &UvUnwrapper::getChartUvs() const
+{
+    return m_chartUvs;
 }
 
-void UvUnwrapper::buildEdgeToFaceMap(const std::vector<size_t> &group, std::map<std::pair<size_t, size_t>, size_t> &edgeToFaceMap)
+void UvUnwrapper::buildEdgeToFaceMap(const std::vector<CompactFace> &faces, std::map<std::pair<Index, Index>, Index> &edgeToFaceMap)
 {
     edgeToFaceMap.clear();
-    for (const auto &index: group) {
-        const auto &face = m_mesh.faces[index];
+    for (decltype(faces.size()) index = 0; index < faces.size(); ++index) {
+        const auto &face = faces[index];
         for (size_t i = 0; i < 3; i++) {
             size_t j = (i + 1) % 3;
             edgeToFaceMap[{face.indices[i], face.indices[j]}] = index;
@@ -64,44 +113,147 @@ void UvUnwrapper::buildEdgeToFaceMap(const std::vector<size_t> &group, std::map<
     }
 }
 
-void UvUnwrapper::splitPartitionToIslands(const std::vector<size_t> &group, std::vector<std::vector<size_t>> &islands)
+void UvUnwrapper::splitPartitionToIslands(const Index *group, size_t groupSize, std::vector<std::vector<Index>> &islands,
+        std::vector<size_t> *islandBoundaryEdgeNums)
 {
-    std::map<std::pair<size_t, size_t>, size_t> edgeToFaceMap;
-    buildEdgeToFaceMap(group, edgeToFaceMap);
-    bool segmentByNormal = !m_mesh.faceNormals.empty() && m_segmentByNormal;
+    std::vector<Index> oppositeFaces;
+    buildOppositeFaces(m_mesh.faces, group, groupSize, oppositeFaces);
+    bool segmentByNormal = m_mesh.faceNormals.size() == m_mesh.faces.size() && m_segmentByNormal;
     
-    std::unordered_set<size_t> processedFaces;
-    std::queue<size_t> waitFaces;
-    for (const auto &indexInGroup: group) {
-        if (processedFaces.find(indexInGroup) != processedFaces.end())
+    // Comparing with the adjacent face, when more pieces are not preferred, only depends on the edge, so it's tested
+    // for all the edges in one go. The default comparing with the seed face has to be done while growing the island
+    std::vector<unsigned char> passedEdges;
+    if (segmentByNormal && !m_segmentPreferMorePieces)
+        testAdjacentFaceNormals(m_mesh.faceNormals, group, oppositeFaces, m_segmentDotProductThreshold, passedEdges);
+    
+    bool mergeIslands = m_smallIslandFaceNum > 0;
+    std::vector<Index> faceIslands;
+    if (mergeIslands)
+        faceIslands.resize(groupSize);
+    size_t firstIsland = islands.size();
+    std::vector<bool> processedFaces(groupSize, false);
+    std::queue<Index> waitFaces;
+    for (size_t seed = 0; seed < groupSize; ++seed) {
+        if (processedFaces[seed])
             continue;
-        waitFaces.push(indexInGroup);
-        std::vector<size_t> island;
+        waitFaces.push(seed);
+        const Vector3 *seedNormal = segmentByNormal ? &m_mesh.faceNormals[group[seed]] : nullptr;
+        std::vector<Index> island;
+        size_t boundaryEdgeNum = 0;
         while (!waitFaces.empty()) {
             size_t index = waitFaces.front();
             waitFaces.pop();
-            if (processedFaces.find(index) != processedFaces.end())
+            if (processedFaces[index])
                 continue;
-            const auto &face = m_mesh.faces[index];
             for (size_t i = 0; i < 3; i++) {
-                size_t j = (i + 1) % 3;
-                auto findOppositeFaceResult = edgeToFaceMap.find({face.indices[j], face.indices[i]});
-                if (findOppositeFaceResult == edgeToFaceMap.end())
+                Index opposite = oppositeFaces[index * 3 + i];
+                if ((Index)-1 == opposite) {
+                    ++boundaryEdgeNum;
+                    continue;
+                }
+                if (processedFaces[opposite])
                     continue;
                 if (segmentByNormal) {
-                    if (dotProduct(m_mesh.faceNormals[findOppositeFaceResult->second],
-                            m_mesh.faceNormals[m_segmentPreferMorePieces ? indexInGroup : index]) < m_segmentDotProductThreshold) {
+                    if (m_segmentPreferMorePieces) {
+                        if (dotProduct(m_mesh.faceNormals[group[opposite]], *seedNormal) < m_segmentDotProductThreshold) {
+                            ++boundaryEdgeNum;
+                            continue;
+                        }
+                    } else if (!passedEdges[index * 3 + i]) {
+                        ++boundaryEdgeNum;
                         continue;
                     }
                 }
-                waitFaces.push(findOppositeFaceResult->second);
+                waitFaces.push(opposite);
             }
-            island.push_back(index);
-            processedFaces.insert(index);
+            island.push_back(group[index]);
+            processedFaces[index] = true;
+            if (mergeIslands)
+                faceIslands[index] = islands.size() - firstIsland;
         }
-        if (island.empty())
-            continue;
         islands.push_back(island);
+        if (islandBoundaryEdgeNums)
+            islandBoundaryEdgeNums->push_back(boundaryEdgeNum);
+    }
+    
+    size_t islandNum = islands.size() - firstIsland;
+    if (!mergeIslands || islandNum < 2)
+        return;
+    float maxConeAngle = std::acos(std::max(-1.0f, std::min(1.0f, m_segmentDotProductThreshold)));
+    size_t mergedIslandNum = mergeSmallIslands(m_mesh, group, groupSize, oppositeFaces,
+        m_smallIslandFaceNum, maxConeAngle, faceIslands, islandNum);
+    if (mergedIslandNum == islandNum)
+        return;
+    m_mergedIslandNum += islandNum - mergedIslandNum;
+    islands.resize(firstIsland + mergedIslandNum);
+    for (size_t i = firstIsland; i < islands.size(); ++i)
+        islands[i].clear();
+    if (islandBoundaryEdgeNums) {
+        islandBoundaryEdgeNums->resize(firstIsland);
+        islandBoundaryEdgeNums->resize(firstIsland + mergedIslandNum, 0);
+    }
+    for (size_t index = 0; index < groupSize; ++index) {
+        Index islandIndex = firstIsland + faceIslands[index];
+        islands[islandIndex].push_back(group[index]);
+        if (islandBoundaryEdgeNums) {
+            for (size_t i = 0; i < 3; i++) {
+                Index opposite = oppositeFaces[index * 3 + i];
+                if ((Index)-1 == opposite || faceIslands[opposite] != faceIslands[index])
+                    ++(*islandBoundaryEdgeNums)[islandIndex];
+            }
+        }
+    }
+}
+
+void UvUnwrapper::partitionIsland(const std::vector<Index> &island, std::vector<std::vector<Index>> &charts,
+        std::vector<size_t> &chartBoundaryEdgeNums)
+{
+    std::vector<Index> oppositeFaces;
+    buildOppositeFaces(m_mesh.faces, island.data(), island.size(), oppositeFaces);
+    
+    // Partition the face dual graph
+    std::vector<int> offsets(island.size() + 1, 0);
+    std::vector<int> neighbors;
+    neighbors.reserve(oppositeFaces.size());
+    for (size_t index = 0; index < island.size(); ++index) {
+        for (size_t i = 0; i < 3; i++) {
+            Index opposite = oppositeFaces[index * 3 + i];
+            if ((Index)-1 != opposite)
+                neighbors.push_back((int)opposite);
+        }
+        offsets[index + 1] = neighbors.size();
+    }
+    std::vector<int> parts;
+    partitionGraph(offsets, neighbors, (int)m_maxChartFaceNum, parts);
+    
+    // A part may come in pieces, each connected piece is a chart
+    std::vector<bool> processedFaces(island.size(), false);
+    std::queue<Index> waitFaces;
+    for (size_t seed = 0; seed < island.size(); ++seed) {
+        if (processedFaces[seed])
+            continue;
+        std::vector<Index> chart;
+        size_t boundaryEdgeNum = 0;
+        waitFaces.push(seed);
+        processedFaces[seed] = true;
+        while (!waitFaces.empty()) {
+            Index index = waitFaces.front();
+            waitFaces.pop();
+            chart.push_back(island[index]);
+            for (size_t i = 0; i < 3; i++) {
+                Index opposite = oppositeFaces[index * 3 + i];
+                if ((Index)-1 == opposite || parts[opposite] != parts[index]) {
+                    ++boundaryEdgeNum;
+                    continue;
+                }
+                if (processedFaces[opposite])
+                    continue;
+                processedFaces[opposite] = true;
+                waitFaces.push(opposite);
+            }
+        }
+        charts.push_back(chart);
+        chartBoundaryEdgeNums.push_back(boundaryEdgeNum);
     }
 }
 
@@ -113,50 +265,19 @@ double UvUnwrapper::distanceBetweenVertices(const Vertex &first, const Vertex &s
     return std::sqrt(x*x + y*y + z*z);
 }
 
-void UvUnwrapper::calculateFaceTextureBoundingBox(const std::vector<FaceTextureCoords> &faceTextureCoords,
-        float &left, float &top, float &right, float &bottom)
-{
-    bool leftFirstTime = true;
-    bool topFirstTime = true;
-    bool rightFirstTime = true;
-    bool bottomFirstTime = true;
-    for (const auto &item: faceTextureCoords) {
-        for (int i = 0; i < 3; ++i) {
-            const auto &x = item.coords[i].uv[0];
-            const auto &y = item.coords[i].uv[1];
-            if (leftFirstTime || x < left) {
-                left = x;
-                leftFirstTime = false;
-            }
-            if (rightFirstTime || x > right) {
-                right = x;
-                rightFirstTime = false;
-            }
-            if (topFirstTime || y < top) {
-                top = y;
-                topFirstTime = false;
-            }
-            if (bottomFirstTime || y > bottom) {
-                bottom = y;
-                bottomFirstTime = false;
-            }
-        }
-    }
-}
-
 void UvUnwrapper::triangulateRing(const std::vector<Vertex> &verticies,
-        std::vector<Face> &faces, const std::vector<size_t> &ring)
+        std::vector<CompactFace> &faces, const std::vector<Index> &ring)
 {
     triangulate(verticies, faces, ring);
 }
 
 // The hole filling faces should be put in the back of faces vector, so these uv coords of appended faces will be disgarded.
-bool UvUnwrapper::fixHolesExceptTheLongestRing(const std::vector<Vertex> &verticies, std::vector<Face> &faces, size_t *remainingHoleNum)
+bool UvUnwrapper::fixHolesExceptTheLongestRing(const std::vector<Vertex> &verticies, std::vector<CompactFace> &faces, size_t *remainingHoleNum)
 {
-    std::map<std::pair<size_t, size_t>, size_t> edgeToFaceMap;
+    std::map<std::pair<Index, Index>, Index> edgeToFaceMap;
     buildEdgeToFaceMap(faces, edgeToFaceMap);
     
-    std::map<size_t, std::vector<size_t>> holeVertexLink;
+    std::map<Index, std::vector<Index>> holeVertexLink;
     for (const auto &face: faces) {
         for (size_t i = 0; i < 3; i++) {
             size_t j = (i + 1) % 3;
@@ -167,12 +288,12 @@ bool UvUnwrapper::fixHolesExceptTheLongestRing(const std::vector<Vertex> &vertic
         }
     }
     
-    std::vector<std::pair<std::vector<size_t>, double>> holeRings;
+    std::vector<std::pair<std::vector<Index>, double>> holeRings;
     while (!holeVertexLink.empty()) {
         bool foundRing = false;
-        std::vector<size_t> ring;
-        std::unordered_set<size_t> visited;
-        std::set<std::pair<size_t, size_t>> visitedPath;
+        std::vector<Index> ring;
+        std::unordered_set<Index> visited;
+        std::set<std::pair<Index, Index>> visitedPath;
         double ringLength = 0;
         while (!foundRing) {
             ring.clear();
@@ -247,7 +368,7 @@ bool UvUnwrapper::fixHolesExceptTheLongestRing(const std::vector<Vertex> &vertic
     
     if (holeRings.size() > 1) {
         // Sort by ring length, the longer ring sit in the lower array indices
-        std::sort(holeRings.begin(), holeRings.end(), [](const std::pair<std::vector<size_t>, double> &first, const std::pair<std::vector<size_t>, double> &second) {
+        std::sort(holeRings.begin(), holeRings.end(), [](const std::pair<std::vector<Index>, double> &first, const std::pair<std::vector<Index>, double> &second) {
             return first.second > second.second;
         });
         for (size_t i = 1; i < holeRings.size(); ++i) {
@@ -261,10 +382,69 @@ bool UvUnwrapper::fixHolesExceptTheLongestRing(const std::vector<Vertex> &vertic
     return true;
 }
 
+bool UvUnwrapper::cutToDisk(std::vector<Vertex> &verticies, std::vector<CompactFace> &faces)
+{
+    Eigen::MatrixXd V(verticies.size(), 3);
+    for (size_t i = 0; i < verticies.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            V(i, j) = verticies[i].xyz[j];
+    }
+    Eigen::MatrixXi F(faces.size(), 3);
+    for (size_t i = 0; i < faces.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            F(i, j) = faces[i].indices[j];
+    }
+    if (!igl::is_edge_manifold(F))
+        return false;
+    
+    // Seams along the edges the Gu et al. triangle deletion leaves, a sphere gets none
+    std::vector<std::vector<int>> seams;
+    igl::cut_to_disk(F, seams);
+    if (seams.empty())
+        return false;
+    std::map<std::pair<Index, Index>, Index> edgeToFaceMap;
+    buildEdgeToFaceMap(faces, edgeToFaceMap);
+    Eigen::MatrixXi cuts = Eigen::MatrixXi::Zero(F.rows(), 3);
+    for (const auto &seam: seams) {
+        for (size_t k = 1; k < seam.size(); ++k) {
+            for (const auto &edge: {std::make_pair((Index)seam[k - 1], (Index)seam[k]), std::make_pair((Index)seam[k], (Index)seam[k - 1])}) {
+                auto findFaceResult = edgeToFaceMap.find(edge);
+                if (findFaceResult == edgeToFaceMap.end())
+                    return false;
+                const auto &face = faces[findFaceResult->second];
+                for (size_t j = 0; j < 3; ++j) {
+                    if (face.indices[j] == edge.first)
+                        cuts(findFaceResult->second, j) = 1;
+                }
+            }
+        }
+    }
+    
+    Eigen::MatrixXd cutV;
+    Eigen::MatrixXi cutF;
+    igl::cut_mesh(V, F, cuts, cutV, cutF);
+    std::vector<std::vector<int>> loops;
+    igl::boundary_loop(cutF, loops);
+    if (1 != loops.size())
+        return false;
+    
+    // The faces keep their order, only the seam vertices are duplicated
+    verticies.resize(cutV.rows());
+    for (size_t i = 0; i < verticies.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            verticies[i].xyz[j] = (float)cutV(i, j);
+    }
+    for (size_t i = 0; i < faces.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j)
+            faces[i].indices[j] = (Index)cutF(i, j);
+    }
+    return true;
+}
+
 void UvUnwrapper::makeSeamAndCut(const std::vector<Vertex> &verticies,
-        const std::vector<Face> &faces,
-        std::map<size_t, size_t> &localToGlobalFacesMap,
-        std::vector<size_t> &firstGroup, std::vector<size_t> &secondGroup)
+        const std::vector<CompactFace> &faces,
+        const std::vector<Index> &localToGlobalFaces,
+        std::vector<Index> &firstGroup, std::vector<Index> &secondGroup)
 {
     // We group the chart by first pick the top(max y) triangle, then join the adjecent traigles until the joint count reach to half of total
     
@@ -285,16 +465,16 @@ void UvUnwrapper::makeSeamAndCut(const std::vector<Vertex> &verticies,
     if (-1 == choosenIndex)
         return;
     
-    std::map<std::pair<size_t, size_t>, size_t> edgeToFaceMap;
+    std::map<std::pair<Index, Index>, Index> edgeToFaceMap;
     buildEdgeToFaceMap(faces, edgeToFaceMap);
     
-    std::unordered_set<size_t> processedFaces;
+    std::vector<bool> processedFaces(faces.size(), false);
     std::queue<size_t> waitFaces;
     waitFaces.push(choosenIndex);
     while (!waitFaces.empty()) {
         auto index = waitFaces.front();
         waitFaces.pop();
-        if (processedFaces.find(index) != processedFaces.end())
+        if (processedFaces[index])
             continue;
         const auto &face = faces[index];
         for (size_t i = 0; i < 3; i++) {
@@ -304,15 +484,15 @@ void UvUnwrapper::makeSeamAndCut(const std::vector<Vertex> &verticies,
                 continue;
             waitFaces.push(findOppositeFaceResult->second);
         }
-        processedFaces.insert(index);
-        firstGroup.push_back(localToGlobalFacesMap[index]);
+        processedFaces[index] = true;
+        firstGroup.push_back(localToGlobalFaces[index]);
         if (firstGroup.size() * 2 >= faces.size())
             break;
     }
     for (decltype(faces.size()) index = 0; index < faces.size(); ++index) {
-        if (processedFaces.find(index) != processedFaces.end())
+        if (processedFaces[index])
             continue;
-        secondGroup.push_back(localToGlobalFacesMap[index]);
+        secondGroup.push_back(localToGlobalFaces[index]);
     }
 }
 
@@ -330,117 +510,211 @@ float UvUnwrapper::areaOf2dTriangle(const Eigen::Vector2d &a, const Eigen::Vecto
         Eigen::Vector3d(c.x(), c.y(), 0));
 }
 
+bool UvUnwrapper::calculateChartSize(const FaceTextureCoords *chartUvs, const Index *chartFaces, size_t chartFaceNum,
+        std::pair<float, float> &size, std::pair<float, float> &scaledSize, UvTransform &transform)
+{
+    // The chart uvs stay as parametrized, the placement found here goes into the chart transform
+    float left, top, right, bottom;
+    left = top = right = bottom = 0;
+    calculateTransformedUvBoundingBox(chartUvs, chartFaceNum, identityUvTransform(), left, top, right, bottom);
+    size = {right - left, bottom - top};
+    if (size.first <= 0 || std::isnan(size.first) || std::isinf(size.first) ||
+            size.second <= 0 || std::isnan(size.second) || std::isinf(size.second)) {
+        //qDebug() << "Found invalid chart size:" << size.first << "x" << size.second;
+        return false;
+    }
+    float surfaceArea = 0;
+    for (size_t faceIndex = 0; faceIndex < chartFaceNum; ++faceIndex) {
+        const auto &face = m_mesh.faces[chartFaces[faceIndex]];
+        surfaceArea += areaOf3dTriangle(Eigen::Vector3d(m_mesh.vertices[face.indices[0]].xyz[0],
+                m_mesh.vertices[face.indices[0]].xyz[1],
+                m_mesh.vertices[face.indices[0]].xyz[2]),
+            Eigen::Vector3d(m_mesh.vertices[face.indices[1]].xyz[0],
+                m_mesh.vertices[face.indices[1]].xyz[1],
+                m_mesh.vertices[face.indices[1]].xyz[2]),
+            Eigen::Vector3d(m_mesh.vertices[face.indices[2]].xyz[0],
+                m_mesh.vertices[face.indices[2]].xyz[1],
+                m_mesh.vertices[face.indices[2]].xyz[2]));
+    }
+    float uvArea = 0;
+    for (size_t faceIndex = 0; faceIndex < chartFaceNum; ++faceIndex) {
+        const auto &item = chartUvs[faceIndex];
+        uvArea += areaOf2dTriangle(Eigen::Vector2d(item.coords[0].uv[0], item.coords[0].uv[1]),
+            Eigen::Vector2d(item.coords[1].uv[0], item.coords[1].uv[1]),
+            Eigen::Vector2d(item.coords[2].uv[0], item.coords[2].uv[1]));
+    }
+    transform = translationUvTransform(-left, -top);
+    if (m_enableRotation) {
+        Eigen::Vector3d center(size.first * 0.5, size.second * 0.5, 0);
+        float minRectArea = size.first * size.second;
+        float minRectLeft = 0;
+        float minRectTop = 0;
+        bool rotated = false;
+        for (const auto &degree: m_rotateDegrees) {
+            Eigen::Matrix3d matrix;
+            matrix = Eigen::AngleAxisd(degree * 180.0 / 3.1415926, Eigen::Vector3d::UnitZ());
+            Eigen::Vector3d offset = matrix * -center;
+            UvTransform rotation = {{(float)matrix(0, 0), (float)matrix(0, 1), (float)offset.x(),
+                (float)matrix(1, 0), (float)matrix(1, 1), (float)offset.y()}};
+            UvTransform rotatedTransform = multiplyUvTransforms(rotation, transform);
+            left = top = right = bottom = 0;
+            calculateTransformedUvBoundingBox(chartUvs, chartFaceNum, rotatedTransform, left, top, right, bottom);
+            std::pair<float, float> newSize = {right - left, bottom - top};
+            float newRectArea = newSize.first * newSize.second;
+            if (newRectArea < minRectArea) {
+                minRectArea = newRectArea;
+                size = newSize;
+                minRectLeft = left;
+                minRectTop = top;
+                rotated = true;
+                transform = rotatedTransform;
+            }
+        }
+        if (rotated)
+            transform = multiplyUvTransforms(translationUvTransform(-minRectLeft, -minRectTop), transform);
+    }
+    //qDebug() << "left:" << left << "top:" << top << "right:" << right << "bottom:" << bottom;
+    //qDebug() << "width:" << size.first << "height:" << size.second;
+    float ratioOfSurfaceAreaAndUvArea = uvArea > 0 ? surfaceArea / uvArea : 1.0;
+    float scale = ratioOfSurfaceAreaAndUvArea * m_texelSizePerUnit;
+    scaledSize = std::make_pair(size.first * scale, size.second * scale);
+    return true;
+}
+
 void UvUnwrapper::calculateSizeAndRemoveInvalidCharts()
 {
-    auto charts = m_charts;
-    auto chartSourcePartitions = m_chartSourcePartitions;
-    m_charts.clear();
-    m_chartSourcePartitions.clear();
-    for (size_t chartIndex = 0; chartIndex < charts.size(); ++chartIndex) {
-        auto &chart = charts[chartIndex];
-        float left, top, right, bottom;
-        left = top = right = bottom = 0;
-        calculateFaceTextureBoundingBox(chart.second, left, top, right, bottom);
-        std::pair<float, float> size = {right - left, bottom - top};
-        if (size.first <= 0 || std::isnan(size.first) || std::isinf(size.first) ||
-                size.second <= 0 || std::isnan(size.second) || std::isinf(size.second)) {
-            //qDebug() << "Found invalid chart size:" << size.first << "x" << size.second;
+    // The valid charts are moved towards the front of the chart buffers in place
+    size_t chartNum = m_chartOffsets.size() - 1;
+    size_t validChartNum = 0;
+    size_t validFaceNum = 0;
+    m_chartTransforms.clear();
+    std::vector<size_t> validChartIndices(m_chartShareSources.empty() ? 0 : chartNum, (size_t)-1);
+    for (size_t chartIndex = 0; chartIndex < chartNum; ++chartIndex) {
+        size_t chartBegin = m_chartOffsets[chartIndex];
+        size_t chartEnd = m_chartOffsets[chartIndex + 1];
+        size_t chartFaceNum = chartEnd - chartBegin;
+        std::pair<float, float> size;
+        std::pair<float, float> scaledSize;
+        UvTransform transform;
+        if (!calculateChartSize(m_chartUvs.data() + chartBegin, m_chartFaces.data() + chartBegin, chartFaceNum,
+                size, scaledSize, transform))
             continue;
+        m_chartSizes.push_back(size);
+        m_scaledChartSizes.push_back(scaledSize);
+        m_chartTransforms.push_back(transform);
+        if (validFaceNum != chartBegin) {
+            std::copy(m_chartFaces.begin() + chartBegin, m_chartFaces.begin() + chartEnd, m_chartFaces.begin() + validFaceNum);
+            std::copy(m_chartUvs.begin() + chartBegin, m_chartUvs.begin() + chartEnd, m_chartUvs.begin() + validFaceNum);
         }
-        float surfaceArea = 0;
-        for (const auto &item: chart.first) {
-            const auto &face = m_mesh.faces[item];
-            surfaceArea += areaOf3dTriangle(Eigen::Vector3d(m_mesh.vertices[face.indices[0]].xyz[0],
-                    m_mesh.vertices[face.indices[0]].xyz[1],
-                    m_mesh.vertices[face.indices[0]].xyz[2]),
-                Eigen::Vector3d(m_mesh.vertices[face.indices[1]].xyz[0],
-                    m_mesh.vertices[face.indices[1]].xyz[1],
-                    m_mesh.vertices[face.indices[1]].xyz[2]),
-                Eigen::Vector3d(m_mesh.vertices[face.indices[2]].xyz[0],
-                    m_mesh.vertices[face.indices[2]].xyz[1],
-                    m_mesh.vertices[face.indices[2]].xyz[2]));
-        }
-        float uvArea = 0;
-        for (auto &item: chart.second) {
-            for (int i = 0; i < 3; ++i) {
-                item.coords[i].uv[0] -= left;
-                item.coords[i].uv[1] -= top;
-            }
-            uvArea += areaOf2dTriangle(Eigen::Vector2d(item.coords[0].uv[0], item.coords[0].uv[1]),
-                Eigen::Vector2d(item.coords[1].uv[0], item.coords[1].uv[1]),
-                Eigen::Vector2d(item.coords[2].uv[0], item.coords[2].uv[1]));
-        }
-        if (m_enableRotation) {
-            Eigen::Vector3d center(size.first * 0.5, size.second * 0.5, 0);
-            float minRectArea = size.first * size.second;
-            float minRectLeft = 0;
-            float minRectTop = 0;
-            bool rotated = false;
-            for (const auto &degree: m_rotateDegrees) {
-                Eigen::Matrix3d matrix;
-                matrix = Eigen::AngleAxisd(degree * 180.0 / 3.1415926, Eigen::Vector3d::UnitZ());
-                std::vector<FaceTextureCoords> rotatedUvs;
-                for (auto &item: chart.second) {
-                    FaceTextureCoords rotatedCoords;
-                    for (int i = 0; i < 3; ++i) {
-                        Eigen::Vector3d point(item.coords[i].uv[0], item.coords[i].uv[1], 0);
-                        point -= center;
-                        point = matrix * point;
-                        rotatedCoords.coords[i].uv[0] = point.x();
-                        rotatedCoords.coords[i].uv[1] = point.y();
-                    }
-                    rotatedUvs.push_back(rotatedCoords);
-                }
-                left = top = right = bottom = 0;
-                calculateFaceTextureBoundingBox(rotatedUvs, left, top, right, bottom);
-                std::pair<float, float> newSize = {right - left, bottom - top};
-                float newRectArea = newSize.first * newSize.second;
-                if (newRectArea < minRectArea) {
-                    minRectArea = newRectArea;
-                    size = newSize;
-                    minRectLeft = left;
-                    minRectTop = top;
-                    rotated = true;
-                    chart.second = rotatedUvs;
-                }
-            }
-            if (rotated) {
-                for (auto &item: chart.second) {
-                    for (int i = 0; i < 3; ++i) {
-                        item.coords[i].uv[0] -= minRectLeft;
-                        item.coords[i].uv[1] -= minRectTop;
-                    }
-                }
-            }
+        validFaceNum += chartFaceNum;
+        m_chartOffsets[validChartNum + 1] = validFaceNum;
+        m_chartSourcePartitions[validChartNum] = m_chartSourcePartitions[chartIndex];
+        if (!m_chartShareSources.empty()) {
+            // A copy of an invalid chart keeps its own place
+            validChartIndices[chartIndex] = validChartNum;
+            size_t shareSource = validChartIndices[m_chartShareSources[chartIndex]];
+            m_chartShareSources[validChartNum] = (size_t)-1 == shareSource ? validChartNum : shareSource;
         }
-        //qDebug() << "left:" << left << "top:" << top << "right:" << right << "bottom:" << bottom;
-        //qDebug() << "width:" << size.first << "height:" << size.second;
-        float ratioOfSurfaceAreaAndUvArea = uvArea > 0 ? surfaceArea / uvArea : 1.0;
-        float scale = ratioOfSurfaceAreaAndUvArea * m_texelSizePerUnit;
-        m_chartSizes.push_back(size);
-        m_scaledChartSizes.push_back(std::make_pair(size.first * scale, size.second * scale));
-        m_charts.push_back(chart);
-        m_chartSourcePartitions.push_back(chartSourcePartitions[chartIndex]);
+        ++validChartNum;
     }
+    m_chartOffsets.resize(validChartNum + 1);
+    m_chartFaces.resize(validFaceNum);
+    m_chartUvs.resize(validFaceNum);
+    m_chartSourcePartitions.resize(validChartNum);
+    if (!m_chartShareSources.empty())
+        m_chartShareSources.resize(validChartNum);
 }
 
 void UvUnwrapper::packCharts()
 {
-    ChartPacker chartPacker;
-    chartPacker.setCharts(m_scaledChartSizes);
-    m_resultTextureSize = chartPacker.pack();
+    std::vector<std::tuple<float, float, float, float, bool>> packedResult;
+    std::vector<int> packedPages;
+    m_resultPageNum = 1;
+    m_chartPixelRects.clear();
+    
+    // Charts sharing the atlas space of a congruent chart are left out, and take its place after packing
+    std::vector<size_t> packedCharts;
+    bool shareAtlasSpace = !m_chartShareSources.empty() && !m_streamingChartPacker;
+    for (size_t i = 0; i < m_chartTransforms.size(); ++i) {
+        if (!shareAtlasSpace || m_chartShareSources[i] == i)
+            packedCharts.push_back(i);
+    }
+    if (m_rasterPackResolution > 0) {
+        RasterChartPacker rasterChartPacker;
+        rasterChartPacker.setResolution(m_rasterPackResolution);
+        rasterChartPacker.setPaddingPixels(m_rasterPackPaddingPixels);
+        rasterChartPacker.setThreadNum(m_threadNum);
+        for (size_t i: packedCharts) {
+            const auto &chartSize = m_chartSizes[i];
+            const auto &scaledChartSize = m_scaledChartSizes[i];
+            UvTransform scale = {{scaledChartSize.first / chartSize.first, 0, 0,
+                0, scaledChartSize.second / chartSize.second, 0}};
+            size_t chartBegin = m_chartOffsets[i];
+            rasterChartPacker.addChart(m_chartUvs.data() + chartBegin, m_chartOffsets[i + 1] - chartBegin,
+                multiplyUvTransforms(scale, m_chartTransforms[i]), scaledChartSize);
+        }
+        m_resultTextureSize = rasterChartPacker.pack();
+        packedResult = rasterChartPacker.getResult();
+    } else if (m_streamingChartPacker) {
+        m_resultTextureSize = m_streamingChartPacker->finish();
+        const auto &streamedResult = m_streamingChartPacker->getResult();
+        packedResult.resize(m_chartStreamIndices.size());
+        for (size_t i = 0; i < m_chartStreamIndices.size(); ++i) {
+            if (m_chartStreamIndices[i] >= streamedResult.size()) {
+                packedResult.resize(i);
+                break;
+            }
+            packedResult[i] = streamedResult[m_chartStreamIndices[i]];
+        }
+    } else {
+        ChartPacker chartPacker;
+        if (m_skylinePackMinChartNum > 0 && packedCharts.size() >= m_skylinePackMinChartNum)
+            chartPacker.setMethod(ChartPacker::Method::Skyline);
+        chartPacker.setPageSize(m_pageSize);
+        chartPacker.setTexelResolution(m_texelPackResolution, m_texelPackPaddingPixels);
+        if (packedCharts.size() == m_scaledChartSizes.size()) {
+            chartPacker.setCharts(m_scaledChartSizes);
+        } else {
+            std::vector<std::pair<float, float>> packedChartSizes;
+            packedChartSizes.reserve(packedCharts.size());
+            for (size_t i: packedCharts)
+                packedChartSizes.push_back(m_scaledChartSizes[i]);
+            chartPacker.setCharts(packedChartSizes);
+        }
+        m_resultTextureSize = chartPacker.pack();
+        packedResult = chartPacker.getResult();
+        packedPages = chartPacker.getResultPages();
+        m_chartPixelRects = chartPacker.getResultPixelRects();
+        m_resultPageNum = chartPacker.getPageNum();
+    }
+    if (packedCharts.size() != m_chartTransforms.size()) {
+        // A packed chart comes before the charts sharing its place
+        std::vector<size_t> packedIndices(m_chartTransforms.size());
+        for (size_t k = 0; k < packedCharts.size(); ++k)
+            packedIndices[packedCharts[k]] = k;
+        std::vector<std::tuple<float, float, float, float, bool>> sharedResult;
+        std::vector<int> sharedPages;
+        std::vector<PixelRect> sharedPixelRects;
+        for (size_t i = 0; i < m_chartTransforms.size(); ++i) {
+            size_t k = packedIndices[m_chartShareSources[i]];
+            if (k >= packedResult.size())
+                break;
+            sharedResult.push_back(packedResult[k]);
+            if (k < packedPages.size())
+                sharedPages.push_back(packedPages[k]);
+            if (k < m_chartPixelRects.size())
+                sharedPixelRects.push_back(m_chartPixelRects[k]);
+        }
+        packedResult.swap(sharedResult);
+        packedPages.swap(sharedPages);
+        m_chartPixelRects.swap(sharedPixelRects);
+    }
     m_chartRects.resize(m_chartSizes.size());
-    const std::vector<std::tuple<float, float, float, float, bool>> &packedResult = chartPacker.getResult();
-    for (decltype(m_charts.size()) i = 0; i < m_charts.size(); ++i) {
+    for (size_t i = 0; i < m_chartTransforms.size(); ++i) {
         const auto &chartSize = m_chartSizes[i];
-        auto &chart = m_charts[i];
+        auto &transform = m_chartTransforms[i];
         if (i >= packedResult.size()) {
-            for (auto &item: chart.second) {
-                for (int i = 0; i < 3; ++i) {
-                    item.coords[i].uv[0] = 0;
-                    item.coords[i].uv[1] = 0;
-                }
-            }
+            transform = {{0, 0, 0, 0, 0, 0}};
             continue;
         }
         const auto &result = packedResult[i];
@@ -449,85 +723,98 @@ void UvUnwrapper::packCharts()
         auto &width = std::get<2>(result);
         auto &height = std::get<3>(result);
         auto &flipped = std::get<4>(result);
+        int page = i < packedPages.size() ? packedPages[i] : 0;
         if (flipped)
-            m_chartRects[i] = {left, top, height, width};
+            m_chartRects[i] = {left, top, height, width, page};
         else
-            m_chartRects[i] = {left, top, width, height};
-        if (flipped) {
-            for (auto &item: chart.second) {
-                for (int i = 0; i < 3; ++i) {
-                    std::swap(item.coords[i].uv[0], item.coords[i].uv[1]);
-                }
-            }
-        }
-        for (auto &item: chart.second) {
-            for (int i = 0; i < 3; ++i) {
-                item.coords[i].uv[0] /= chartSize.first;
-                item.coords[i].uv[1] /= chartSize.second;
-                item.coords[i].uv[0] *= width;
-                item.coords[i].uv[1] *= height;
-                item.coords[i].uv[0] += left;
-                item.coords[i].uv[1] += top;
-            }
-        }
+            m_chartRects[i] = {left, top, width, height, page};
+        if (flipped)
+            transform = multiplyUvTransforms({{0, 1, 0, 1, 0, 0}}, transform);
+        UvTransform placement = {{width / chartSize.first, 0, left, 0, height / chartSize.second, top}};
+        transform = multiplyUvTransforms(placement, transform);
     }
 }
 
 void UvUnwrapper::finalizeUv()
 {
     m_faceUvs.resize(m_mesh.faces.size());
-    for (const auto &chart: m_charts) {
-        for (decltype(chart.second.size()) i = 0; i < chart.second.size(); ++i) {
-            auto &faceUv = m_faceUvs[chart.first[i]];
-            faceUv = chart.second[i];
-        }
+    std::vector<FaceTextureCoords> transformedUvs;
+    for (size_t i = 0; i < m_chartTransforms.size(); ++i) {
+        size_t chartBegin = m_chartOffsets[i];
+        size_t chartFaceNum = m_chartOffsets[i + 1] - chartBegin;
+        transformedUvs.resize(chartFaceNum);
+        transformUvs(m_chartUvs.data() + chartBegin, chartFaceNum, m_chartTransforms[i], transformedUvs.data());
+        for (size_t j = 0; j < chartFaceNum; ++j)
+            m_faceUvs[m_chartFaces[chartBegin + j]] = transformedUvs[j];
     }
 }
 
 void UvUnwrapper::partition()
 {
-    m_partitions.clear();
+    // Counting sort the faces by partition, all the partitions share one face buffer
+    size_t faceNum = m_mesh.faces.size();
+    m_partitionIds.clear();
+    m_partitionOffsets.clear();
+    m_partitionFaces.resize(faceNum);
     if (m_mesh.facePartitions.empty()) {
-        for (decltype(m_mesh.faces.size()) i = 0; i < m_mesh.faces.size(); i++) {
-            m_partitions[0].push_back(i);
-        }
-    } else {
-        for (decltype(m_mesh.faces.size()) i = 0; i < m_mesh.faces.size(); i++) {
-            int partition = m_mesh.facePartitions[i];
-            m_partitions[partition].push_back(i);
-        }
+        m_partitionIds.push_back(0);
+        m_partitionOffsets.push_back(0);
+        m_partitionOffsets.push_back(faceNum);
+        for (size_t i = 0; i < faceNum; i++)
+            m_partitionFaces[i] = (Index)i;
+        return;
     }
+    m_partitionIds.assign(m_mesh.facePartitions.begin(), m_mesh.facePartitions.begin() + faceNum);
+    std::sort(m_partitionIds.begin(), m_partitionIds.end());
+    m_partitionIds.erase(std::unique(m_partitionIds.begin(), m_partitionIds.end()), m_partitionIds.end());
+    std::vector<Index> faceRanks(faceNum);
+    m_partitionOffsets.resize(m_partitionIds.size() + 1, 0);
+    for (size_t i = 0; i < faceNum; i++) {
+        Index rank = (Index)(std::lower_bound(m_partitionIds.begin(), m_partitionIds.end(), m_mesh.facePartitions[i]) - m_partitionIds.begin());
+        faceRanks[i] = rank;
+        ++m_partitionOffsets[rank + 1];
+    }
+    for (size_t i = 1; i < m_partitionOffsets.size(); ++i)
+        m_partitionOffsets[i] += m_partitionOffsets[i - 1];
+    std::vector<size_t> positions(m_partitionOffsets.begin(), m_partitionOffsets.end() - 1);
+    for (size_t i = 0; i < faceNum; i++)
+        m_partitionFaces[positions[faceRanks[i]]++] = (Index)i;
 }
 
-void UvUnwrapper::unwrapSingleIsland(const std::vector<size_t> &group, int sourcePartition, bool skipCheckHoles)
+void UvUnwrapper::unwrapSingleIsland(IslandTask &task, IslandWorker &worker)
 {
+    const auto &group = task.faces;
     if (group.empty())
         return;
     
+    auto &vertexRemap = worker.vertexRemap;
+    
+    // Local face i is the global face group[i], so the group itself maps the faces back
+    ++vertexRemap.epoch;
+    if (0 == vertexRemap.epoch) {
+        std::fill(vertexRemap.epochs.begin(), vertexRemap.epochs.end(), 0);
+        vertexRemap.epoch = 1;
+    }
+    if (vertexRemap.epochs.size() < m_mesh.vertices.size()) {
+        vertexRemap.epochs.resize(m_mesh.vertices.size(), 0);
+        vertexRemap.localIndices.resize(m_mesh.vertices.size());
+    }
     std::vector<Vertex> localVertices;
-    std::vector<Face> localFaces;
-    std::map<size_t, size_t> globalToLocalVerticesMap;
-    std::map<size_t, size_t> localToGlobalFacesMap;
+    std::vector<CompactFace> localFaces(group.size());
     for (decltype(group.size()) i = 0; i < group.size(); ++i) {
         const auto &globalFace = m_mesh.faces[group[i]];
-        Face localFace;
+        auto &localFace = localFaces[i];
         for (size_t j = 0; j < 3; j++) {
-            int globalVertexIndex = globalFace.indices[j];
-            if (globalToLocalVerticesMap.find(globalVertexIndex) == globalToLocalVerticesMap.end()) {
+            Index globalVertexIndex = globalFace.indices[j];
+            if (vertexRemap.epochs[globalVertexIndex] != vertexRemap.epoch) {
+                vertexRemap.epochs[globalVertexIndex] = vertexRemap.epoch;
+                vertexRemap.localIndices[globalVertexIndex] = (Index)localVertices.size();
                 localVertices.push_back(m_mesh.vertices[globalVertexIndex]);
-                globalToLocalVerticesMap[globalVertexIndex] = (int)localVertices.size() - 1;
             }
-            localFace.indices[j] = globalToLocalVerticesMap[globalVertexIndex];
+            localFace.indices[j] = vertexRemap.localIndices[globalVertexIndex];
         }
-        localFaces.push_back(localFace);
-        localToGlobalFacesMap[localFaces.size() - 1] = group[i];
     }
 
-    //if (skipCheckHoles) {
-    //    parametrizeSingleGroup(localVertices, localFaces, localToGlobalFacesMap, localFaces.size());
-    //    return;
-    //}
-
     decltype(localFaces.size()) faceNumBeforeFix = localFaces.size();
     size_t remainingHoleNumAfterFix = 0;
     if (!fixHolesExceptTheLongestRing(localVertices, localFaces, &remainingHoleNumAfterFix)) {
@@ -535,53 +822,312 @@ void UvUnwrapper::unwrapSingleIsland(const std::vector<size_t> &group, int sourc
         return;
     }
     if (1 == remainingHoleNumAfterFix) {
-        parametrizeSingleGroup(localVertices, localFaces, localToGlobalFacesMap, faceNumBeforeFix, sourcePartition);
+        parametrizeSingleGroup(localVertices, localFaces, faceNumBeforeFix, task, worker);
         return;
     }
     
     if (0 == remainingHoleNumAfterFix) {
-        std::vector<size_t> firstGroup;
-        std::vector<size_t> secondGroup;
-        makeSeamAndCut(localVertices, localFaces, localToGlobalFacesMap, firstGroup, secondGroup);
+        if (m_cutClosedIslandsToDisk) {
+            std::vector<Vertex> cutVertices = localVertices;
+            std::vector<CompactFace> cutFaces = localFaces;
+            if (cutToDisk(cutVertices, cutFaces)) {
+                parametrizeSingleGroup(cutVertices, cutFaces, faceNumBeforeFix, task, worker);
+                return;
+            }
+        }
+        std::vector<Index> firstGroup;
+        std::vector<Index> secondGroup;
+        makeSeamAndCut(localVertices, localFaces, group, firstGroup, secondGroup);
         if (firstGroup.empty() || secondGroup.empty()) {
             //qDebug() << "Cut mesh failed";
             return;
         }
-        unwrapSingleIsland(firstGroup, sourcePartition, true);
-        unwrapSingleIsland(secondGroup, sourcePartition, true);
+        // The halves are left to the scheduler, so other workers can steal them
+        std::vector<Index> *groups[] = {&firstGroup, &secondGroup};
+        for (size_t i = 0; i < 2; ++i) {
+            task.subIslands[i].reset(new IslandTask);
+            task.subIslands[i]->faces.swap(*groups[i]);
+            task.subIslands[i]->sourcePartition = task.sourcePartition;
+        }
         return;
     }
 }
 
 void UvUnwrapper::parametrizeSingleGroup(const std::vector<Vertex> &verticies,
-        const std::vector<Face> &faces,
-        std::map<size_t, size_t> &localToGlobalFacesMap,
+        const std::vector<CompactFace> &faces,
         size_t faceNumToChart,
-        int sourcePartition)
+        IslandTask &task,
+        IslandWorker &worker)
 {
-    std::vector<TextureCoord> localVertexUvs;
-    if (!parametrize(verticies, faces, localVertexUvs))
+    if (0 == faceNumToChart)
+        return;
+    std::vector<TextureCoord> localVertexUvs(verticies.size());
+    // The islands already keep every thread busy, a solve starting threads of its own would only oversubscribe them
+    ArapOptions arapOptions = m_arapOptions;
+    arapOptions.threadNum = 1;
+    if (!parametrize(verticies, faces, localVertexUvs.data(), arapOptions, m_parametrizationMethod))
         return;
-    std::pair<std::vector<size_t>, std::vector<FaceTextureCoords>> chart;
+    // The first faceNumToChart local faces are the task faces, the chart lands in the worker's buffer
+    // and is collected in island order after all the workers finished
+    size_t chartBegin = worker.chartUvs.size();
+    worker.chartUvs.resize(chartBegin + faceNumToChart);
     for (size_t i = 0; i < faceNumToChart; ++i) {
         const auto &localFace = faces[i];
-        auto globalFaceIndex = localToGlobalFacesMap[i];
-        FaceTextureCoords faceUv;
-        for (size_t j = 0; j < 3; j++) {
-            const auto &localVertexIndex = localFace.indices[j];
-            const auto &vertexUv = localVertexUvs[localVertexIndex];
-            faceUv.coords[j].uv[0] = vertexUv.uv[0];
-            faceUv.coords[j].uv[1] = vertexUv.uv[1];
+        auto &faceUv = worker.chartUvs[chartBegin + i];
+        for (size_t j = 0; j < 3; j++)
+            faceUv.coords[j] = localVertexUvs[localFace.indices[j]];
+    }
+    task.chartWorker = &worker;
+    task.chartUvBegin = chartBegin;
+    task.chartFaceNum = faceNumToChart;
+    if (m_streamingChartPacker) {
+        // Size the chart and hand it to the packer right away, while the other workers keep parametrizing
+        StreamedChart streamedChart;
+        if (!calculateChartSize(worker.chartUvs.data() + chartBegin, task.faces.data(), faceNumToChart,
+                streamedChart.size, streamedChart.scaledSize, streamedChart.transform))
+            return;
+        streamedChart.streamIndex = m_streamingChartPacker->addChart(streamedChart.scaledSize, faceNumToChart);
+        task.streamedChart.reset(new StreamedChart(streamedChart));
+    }
+}
+
+void UvUnwrapper::unwrapIslands(std::vector<std::unique_ptr<IslandTask>> &islandTasks, std::vector<IslandWorker> &workers)
+{
+    std::vector<IslandTask *> largestFirstTasks;
+    for (const auto &task: islandTasks) {
+        if (nullptr == task->representative)
+            largestFirstTasks.push_back(task.get());
+    }
+    std::stable_sort(largestFirstTasks.begin(), largestFirstTasks.end(), [](const IslandTask *first, const IslandTask *second) {
+        return first->cost > second->cost;
+    });
+    
+    size_t threadNum = m_threadNum;
+    if (0 == threadNum)
+        threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+    WorkStealingPool pool(threadNum);
+    workers.resize(pool.workerNum());
+    
+    std::function<void(IslandTask *, size_t)> runIsland = [&](IslandTask *task, size_t workerIndex) {
+        unwrapSingleIsland(*task, workers[workerIndex]);
+        for (const auto &subIsland: task->subIslands) {
+            if (!subIsland)
+                continue;
+            IslandTask *subTask = subIsland.get();
+            pool.spawn(workerIndex, [&runIsland, subTask](size_t workerIndex) {
+                runIsland(subTask, workerIndex);
+            });
+        }
+    };
+    std::vector<WorkStealingPool::Task> tasks;
+    for (const auto &task: largestFirstTasks) {
+        tasks.push_back([&runIsland, task](size_t workerIndex) {
+            runIsland(task, workerIndex);
+        });
+    }
+    pool.run(tasks);
+}
+
+void UvUnwrapper::collectCharts(IslandTask &task)
+{
+    if (nullptr != task.chartWorker && (!m_streamingChartPacker || task.streamedChart)) {
+        if (task.streamedChart) {
+            m_chartSizes.push_back(task.streamedChart->size);
+            m_scaledChartSizes.push_back(task.streamedChart->scaledSize);
+            m_chartTransforms.push_back(task.streamedChart->transform);
+            m_chartStreamIndices.push_back(task.streamedChart->streamIndex);
         }
-        chart.first.push_back(globalFaceIndex);
-        chart.second.push_back(faceUv);
+        auto chartUvs = task.chartWorker->chartUvs.begin() + task.chartUvBegin;
+        m_chartFaces.insert(m_chartFaces.end(), task.faces.begin(), task.faces.begin() + task.chartFaceNum);
+        m_chartUvs.insert(m_chartUvs.end(), chartUvs, chartUvs + task.chartFaceNum);
+        m_chartOffsets.push_back(m_chartFaces.size());
+        m_chartSourcePartitions.push_back(task.sourcePartition);
+        task.chartIndex = m_chartSourcePartitions.size() - 1;
+        if (m_shareCongruentAtlasSpace && m_reusedIslandNum > 0) {
+            bool shared = nullptr != task.shareSource && (size_t)-1 != task.shareSource->chartIndex;
+            m_chartShareSources.push_back(shared ? task.shareSource->chartIndex : task.chartIndex);
+        }
+    }
+    for (const auto &subIsland: task.subIslands) {
+        if (subIsland)
+            collectCharts(*subIsland);
+    }
+}
+
+void UvUnwrapper::findCongruentIslands(std::vector<std::unique_ptr<IslandTask>> &islandTasks)
+{
+    // Edge lengths have to match within a thousandth of the mean edge length. The fingerprints round them
+    // coarser, copies of the same island only differ by float rounding and land on the same step
+    double lengthSum = 0;
+    for (const auto &face: m_mesh.faces) {
+        for (size_t i = 0; i < 3; i++)
+            lengthSum += distanceBetweenVertices(m_mesh.vertices[face.indices[i]], m_mesh.vertices[face.indices[(i + 1) % 3]]);
     }
-    if (chart.first.empty())
+    if (lengthSum <= 0)
         return;
-    m_charts.push_back(chart);
-    m_chartSourcePartitions.push_back(sourcePartition);
+    float lengthTolerance = lengthSum / (m_mesh.faces.size() * 3) * 1e-3;
+    float lengthQuantum = lengthTolerance * 8;
+    
+    std::vector<uint64_t> fingerprints(islandTasks.size());
+    parallelFor(islandTasks.size(), m_threadNum, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            fingerprints[i] = fingerprintIsland(m_mesh, islandTasks[i]->faces, lengthQuantum);
+    });
+    
+    // The first island of each class is its representative
+    std::unordered_map<uint64_t, std::vector<IslandTask *>> representatives;
+    for (size_t i = 0; i < islandTasks.size(); ++i) {
+        auto &task = *islandTasks[i];
+        auto &candidates = representatives[fingerprints[i]];
+        for (const auto &candidate: candidates) {
+            if (matchCongruentIsland(m_mesh, candidate->faces, task.faces, lengthTolerance, task.cornerRotations)) {
+                task.representative = candidate;
+                ++m_reusedIslandNum;
+                break;
+            }
+        }
+        if (nullptr == task.representative)
+            candidates.push_back(&task);
+    }
+}
+
+void UvUnwrapper::copyCongruentCharts(IslandTask &task, const IslandTask &source, const IslandTask &copy,
+        const std::vector<Index> &sourceFaceIndices, IslandWorker &worker)
+{
+    // sourceFaceIndices maps the faces of the representative to its own face order, which is the order of the copy
+    if (&task != &copy) {
+        task.faces.resize(source.faces.size());
+        for (size_t i = 0; i < source.faces.size(); ++i)
+            task.faces[i] = copy.faces[sourceFaceIndices[source.faces[i]]];
+    }
+    if (nullptr != source.chartWorker) {
+        auto sourceUvs = source.chartWorker->chartUvs.begin() + source.chartUvBegin;
+        size_t chartBegin = worker.chartUvs.size();
+        worker.chartUvs.resize(chartBegin + source.chartFaceNum);
+        for (size_t i = 0; i < source.chartFaceNum; ++i) {
+            size_t rotation = copy.cornerRotations[sourceFaceIndices[source.faces[i]]];
+            auto &faceUv = worker.chartUvs[chartBegin + i];
+            for (size_t j = 0; j < 3; j++)
+                faceUv.coords[(j + rotation) % 3] = sourceUvs[i].coords[j];
+        }
+        task.chartWorker = &worker;
+        task.chartUvBegin = chartBegin;
+        task.chartFaceNum = source.chartFaceNum;
+        if (m_shareCongruentAtlasSpace)
+            task.shareSource = &source;
+        if (source.streamedChart) {
+            if (m_shareCongruentAtlasSpace) {
+                task.streamedChart.reset(new StreamedChart(*source.streamedChart));
+            } else {
+                StreamedChart streamedChart;
+                if (calculateChartSize(worker.chartUvs.data() + chartBegin, task.faces.data(), task.chartFaceNum,
+                        streamedChart.size, streamedChart.scaledSize, streamedChart.transform)) {
+                    streamedChart.streamIndex = m_streamingChartPacker->addChart(streamedChart.scaledSize, task.chartFaceNum);
+                    task.streamedChart.reset(new StreamedChart(streamedChart));
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (!source.subIslands[i])
+            continue;
+        task.subIslands[i].reset(new IslandTask);
+        task.subIslands[i]->sourcePartition = task.sourcePartition;
+        copyCongruentCharts(*task.subIslands[i], *source.subIslands[i], copy, sourceFaceIndices, worker);
+    }
+}
+
+// Sparse factorization of a planar mesh grows about n^1.5 with the face count,
+// the ear clipping of hole filling grows with the square of the boundary length
+double UvUnwrapper::estimateIslandCost(size_t faceNum, size_t boundaryEdgeNum)
+{
+    return faceNum * std::sqrt((double)faceNum) + (double)boundaryEdgeNum * boundaryEdgeNum;
+}
+
+void UvUnwrapper::setThreadNum(size_t threadNum)
+{
+    m_threadNum = threadNum;
 }
 
+void UvUnwrapper::setStreamingPack(bool streamingPack)
+{
+    m_enableStreamingPack = streamingPack;
+}
+
+void UvUnwrapper::setPageSize(float pageSize)
+{
+    m_pageSize = pageSize;
+}
+
+void UvUnwrapper::setRasterPack(int resolution, int paddingPixels)
+{
+    m_rasterPackResolution = resolution;
+    m_rasterPackPaddingPixels = paddingPixels;
+}
+
+void UvUnwrapper::setTexelSnappedPack(int resolution, int paddingPixels)
+{
+    m_texelPackResolution = resolution;
+    m_texelPackPaddingPixels = paddingPixels;
+}
+
+void UvUnwrapper::setArapOptions(const ArapOptions &arapOptions)
+{
+    m_arapOptions = arapOptions;
+}
+
+void UvUnwrapper::setParametrizationMethod(ParametrizationMethod parametrizationMethod)
+{
+    m_parametrizationMethod = parametrizationMethod;
+}
+
+void UvUnwrapper::setCutClosedIslandsToDisk(bool cutClosedIslandsToDisk)
+{
+    m_cutClosedIslandsToDisk = cutClosedIslandsToDisk;
+}
+
+void UvUnwrapper::setMaxChartFaceNum(size_t maxChartFaceNum)
+{
+    m_maxChartFaceNum = maxChartFaceNum;
+}
+
+void UvUnwrapper::setSmallIslandFaceNum(size_t smallIslandFaceNum)
+{
+    m_smallIslandFaceNum = smallIslandFaceNum;
+}
+
+void UvUnwrapper::setSkylinePackMinChartNum(size_t skylinePackMinChartNum)
+{
+    m_skylinePackMinChartNum = skylinePackMinChartNum;
+}
+
+size_t UvUnwrapper::getMergedIslandNum() const
+{
+    return m_mergedIslandNum;
+}
+
+void UvUnwrapper::setReuseCongruentIslands(bool reuseCongruentIslands, bool shareAtlasSpace)
+{
+    m_reuseCongruentIslands = reuseCongruentIslands;
+    m_shareCongruentAtlasSpace = shareAtlasSpace;
+}
+
+size_t UvUnwrapper::getReusedIslandNum() const
+{
+    return m_reusedIslandNum;
+}
+
+const std::vector<PixelRect> &UvUnwrapper::getChartPixelRects() const
+{
+    return m_chartPixelRects;
+}
+
+size_t UvUnwrapper::getPageNum() const
+{
+    return m_resultPageNum;
+}
+
+
 float UvUnwrapper::getTextureSize() const
 {
     return m_resultTextureSize;
@@ -589,17 +1135,91 @@ float UvUnwrapper::getTextureSize() const
 
 void UvUnwrapper::unwrap()
 {
+    if (m_segmentByNormal && m_mesh.faceNormals.size() != m_mesh.faces.size())
+        calculateFaceNormals(m_mesh.vertices, m_mesh.faces, m_mesh.faceNormals);
+    
     partition();
+    m_mergedIslandNum = 0;
+
+    // Every face goes to at most one chart, so the chart buffers never grow after this
+    m_chartOffsets.assign(1, 0);
+    m_chartFaces.clear();
+    m_chartFaces.reserve(m_mesh.faces.size());
+    m_chartUvs.clear();
+    m_chartUvs.reserve(m_mesh.faces.size());
+    m_chartSourcePartitions.clear();
+    m_chartShareSources.clear();
+    m_chartSizes.clear();
+    m_scaledChartSizes.clear();
 
     m_faceUvs.resize(m_mesh.faces.size());
-    for (const auto &group: m_partitions) {
-        std::vector<std::vector<size_t>> islands;
-        splitPartitionToIslands(group.second, islands);
-        for (const auto &island: islands)
-            unwrapSingleIsland(island, group.first);
+    std::vector<std::unique_ptr<IslandTask>> islandTasks;
+    for (size_t i = 0; i < m_partitionIds.size(); ++i) {
+        std::vector<std::vector<Index>> islands;
+        std::vector<size_t> islandBoundaryEdgeNums;
+        splitPartitionToIslands(m_partitionFaces.data() + m_partitionOffsets[i],
+            m_partitionOffsets[i + 1] - m_partitionOffsets[i], islands, &islandBoundaryEdgeNums);
+        if (m_maxChartFaceNum > 0) {
+            std::vector<std::vector<Index>> charts;
+            std::vector<size_t> chartBoundaryEdgeNums;
+            for (size_t j = 0; j < islands.size(); ++j) {
+                if (islands[j].size() <= m_maxChartFaceNum) {
+                    charts.push_back(std::vector<Index>());
+                    charts.back().swap(islands[j]);
+                    chartBoundaryEdgeNums.push_back(islandBoundaryEdgeNums[j]);
+                    continue;
+                }
+                partitionIsland(islands[j], charts, chartBoundaryEdgeNums);
+            }
+            islands.swap(charts);
+            islandBoundaryEdgeNums.swap(chartBoundaryEdgeNums);
+        }
+        for (size_t j = 0; j < islands.size(); ++j) {
+            std::unique_ptr<IslandTask> task(new IslandTask);
+            task->faces.swap(islands[j]);
+            task->sourcePartition = m_partitionIds[i];
+            task->cost = estimateIslandCost(task->faces.size(), islandBoundaryEdgeNums[j]);
+            islandTasks.push_back(std::move(task));
+        }
+    }
+    //qDebug() << "Merged small islands:" << m_mergedIslandNum;
+    m_reusedIslandNum = 0;
+    if (m_reuseCongruentIslands)
+        findCongruentIslands(islandTasks);
+    //qDebug() << "Congruent islands reused:" << m_reusedIslandNum;
+    m_chartTransforms.clear();
+    m_chartStreamIndices.clear();
+    m_streamingChartPacker.reset();
+    if (m_enableStreamingPack && m_pageSize <= 0 && m_rasterPackResolution <= 0 && m_texelPackResolution <= 0) {
+        m_streamingChartPacker.reset(new StreamingChartPacker);
+        // Copies sharing the place of their representative are not added
+        size_t streamedFaceNum = 0;
+        for (const auto &task: islandTasks) {
+            if (nullptr == task->representative || !m_shareCongruentAtlasSpace)
+                streamedFaceNum += task->faces.size();
+        }
+        m_streamingChartPacker->setExpectedFaceNum(streamedFaceNum);
+    }
+    std::vector<IslandWorker> workers;
+    unwrapIslands(islandTasks, workers);
+    IslandWorker congruentWorker;
+    if (m_reusedIslandNum > 0) {
+        std::vector<Index> sourceFaceIndices(m_mesh.faces.size());
+        for (const auto &task: islandTasks) {
+            if (nullptr == task->representative)
+                continue;
+            const auto &representative = *task->representative;
+            for (size_t i = 0; i < representative.faces.size(); ++i)
+                sourceFaceIndices[representative.faces[i]] = (Index)i;
+            copyCongruentCharts(*task, representative, *task, sourceFaceIndices, congruentWorker);
+        }
     }
+    for (const auto &task: islandTasks)
+        collectCharts(*task);
     
-    calculateSizeAndRemoveInvalidCharts();
+    // Streamed charts were sized and dropped when invalid while unwrapping
+    if (!m_streamingChartPacker)
+        calculateSizeAndRemoveInvalidCharts();
     packCharts();
     finalizeUv();
 }
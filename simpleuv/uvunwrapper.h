@@ -3,64 +3,197 @@
 #include <vector>
 #include <map>
 #include <simpleuv/meshdatatype.h>
+#include <simpleuv/streamingchartpacker.h>
+#include <simpleuv/arapsolver.h>
+#include <simpleuv/parametrize.h>
 #include <Eigen/Dense>
 #include <tuple>
+#include <memory>
 
 namespace simpleuv 
 {
 
+// Global to local vertex index scratch sized to the whole mesh, entries stamped with an older epoch
+// are unmapped, so it's reused from island to island without clearing. Each thread needs its own.
+struct VertexRemap
+{
+    std::vector<Index> localIndices;
+    std::vector<uint32_t> epochs;
+    uint32_t epoch = 0;
+};
+
 class UvUnwrapper
 {
 public:
     void setMesh(const Mesh &mesh);
     void setTexelSize(float texelSize);
+    // By default a face joins an island only when its normal is within the segmentation angle of the island's first face.
+    // Turned off, a face is only compared with the face across the edge, which is tested for all the edges in one pass
+    // before growing, but lets the islands bend around smooth surfaces
+    void setSegmentPreferMorePieces(bool segmentPreferMorePieces);
+    // Islands are unwrapped on this many threads, 0 means one per hardware thread
+    void setThreadNum(size_t threadNum);
+    // Pack every chart as soon as it's parametrized instead of after all the islands are done.
+    // Charts are placed in the order the threads finish them, so the layout can differ from run to run
+    void setStreamingPack(bool streamingPack);
+    // Pack into fixed size square pages, in the same unit as getTextureSize(), instead of one growing texture.
+    // getChartRects() then tells the page of each chart and the rects and uvs are relative to that page.
+    // Streaming pack doesn't apply to pages. 0 turns it off
+    void setPageSize(float pageSize);
+    // Pack the rasterized chart footprints on a texture of resolution x resolution pixels instead of the chart rects,
+    // padding is in pixels. Takes precedence over pages and streaming pack. 0 resolution turns it off
+    void setRasterPack(int resolution, int paddingPixels=2);
+    // Pack the chart rects on a resolution x resolution texel grid with whole texel padding,
+    // getChartPixelRects() then gives the exact texels of each chart. Takes precedence over pages and streaming pack
+    void setTexelSnappedPack(int resolution, int paddingPixels=1);
+    // Linear solver and memory budget used by the ARAP parametrization of each island
+    void setArapOptions(const ArapOptions &arapOptions);
+    void setParametrizationMethod(ParametrizationMethod parametrizationMethod);
+    // Open closed islands of genus one or more into a single disk along short seams, instead of halving them
+    // until every piece has a boundary. Spheres are still halved
+    void setCutClosedIslandsToDisk(bool cutClosedIslandsToDisk);
+    // Islands with more faces than this are partitioned into balanced, compact charts of at most this many faces,
+    // which bounds the cost of each solve and gives the threads more to share. 0 turns it off
+    void setMaxChartFaceNum(size_t maxChartFaceNum);
+    // Islands with fewer faces than this are merged into an adjacent island when the result is still a disk
+    // and its normals stay within the segmentation angle, which saves charts on noisy meshes. 0 turns it off
+    void setSmallIslandFaceNum(size_t smallIslandFaceNum);
+    // Pack with the skyline method of ChartPacker once there are at least this many charts. It is much faster on
+    // many charts, but the packing and so the uvs change, with a few percent larger texture. 0 turns it off
+    void setSkylinePackMinChartNum(size_t skylinePackMinChartNum);
+    // Parametrize one island of each class of congruent islands and give the copies the same uvs through their face
+    // correspondence. With shareAtlasSpace the copies are also placed on the chart of their representative
+    void setReuseCongruentIslands(bool reuseCongruentIslands, bool shareAtlasSpace=false);
     void unwrap();
     const std::vector<FaceTextureCoords> &getFaceUvs() const;
     const std::vector<Rect> &getChartRects() const;
+    const std::vector<PixelRect> &getChartPixelRects() const;
     const std::vector<int> &getChartSourcePartitions() const;
+    // Chart i covers [getChartOffsets()[i], getChartOffsets()[i + 1]) of getChartFaces() and getChartUvs().
+    // The chart uvs are left as parametrized, getChartTransforms()[i] maps them to where getFaceUvs() puts them
+    const std::vector<UvTransform> &getChartTransforms() const;
+    const std::vector<size_t> &getChartOffsets() const;
+    const std::vector<Index> &getChartFaces() const;
+    const std::vector<FaceTextureCoords> &getChartUvs() const;
     float getTextureSize() const;
+    size_t getPageNum() const;
+    // Islands removed by merging small islands in the last unwrap
+    size_t getMergedIslandNum() const;
+    // Islands that took their uvs from a congruent island in the last unwrap
+    size_t getReusedIslandNum() const;
 
 private:
+    struct IslandWorker
+    {
+        VertexRemap vertexRemap;
+        std::vector<FaceTextureCoords> chartUvs;
+    };
+
+    struct StreamedChart
+    {
+        std::pair<float, float> size;
+        std::pair<float, float> scaledSize;
+        UvTransform transform;
+        size_t streamIndex;
+    };
+
+    // An island either ends up as one chart kept in chartWorker's buffer, or is cut into two sub islands
+    struct IslandTask
+    {
+        std::vector<Index> faces;
+        int sourcePartition = 0;
+        double cost = 0;
+        IslandWorker *chartWorker = nullptr;
+        size_t chartUvBegin = 0;
+        size_t chartFaceNum = 0;
+        std::unique_ptr<IslandTask> subIslands[2];
+        std::unique_ptr<StreamedChart> streamedChart;
+        // A congruent copy is not parametrized, it takes the charts of its representative.
+        // Its faces are in the order of the representative's, see matchCongruentIsland()
+        const IslandTask *representative = nullptr;
+        std::vector<unsigned char> cornerRotations;
+        const IslandTask *shareSource = nullptr;
+        size_t chartIndex = (size_t)-1;
+    };
+
     void partition();
-    void splitPartitionToIslands(const std::vector<size_t> &group, std::vector<std::vector<size_t>> &islands);
-    void unwrapSingleIsland(const std::vector<size_t> &group, int sourcePartition, bool skipCheckHoles=false);
+    void splitPartitionToIslands(const Index *group, size_t groupSize, std::vector<std::vector<Index>> &islands,
+        std::vector<size_t> *islandBoundaryEdgeNums=nullptr);
+    void partitionIsland(const std::vector<Index> &island, std::vector<std::vector<Index>> &charts,
+        std::vector<size_t> &chartBoundaryEdgeNums);
+    void unwrapIslands(std::vector<std::unique_ptr<IslandTask>> &islandTasks, std::vector<IslandWorker> &workers);
+    void unwrapSingleIsland(IslandTask &task, IslandWorker &worker);
+    void collectCharts(IslandTask &task);
+    void findCongruentIslands(std::vector<std::unique_ptr<IslandTask>> &islandTasks);
+    void copyCongruentCharts(IslandTask &task, const IslandTask &source, const IslandTask &copy,
+        const std::vector<Index> &sourceFaceIndices, IslandWorker &worker);
+    static double estimateIslandCost(size_t faceNum, size_t boundaryEdgeNum);
     void parametrizeSingleGroup(const std::vector<Vertex> &verticies,
-        const std::vector<Face> &faces,
-        std::map<size_t, size_t> &localToGlobalFacesMap,
+        const std::vector<CompactFace> &faces,
         size_t faceNumToChart,
-        int sourcePartition);
-    bool fixHolesExceptTheLongestRing(const std::vector<Vertex> &verticies, std::vector<Face> &faces, size_t *remainingHoleNum=nullptr);
+        IslandTask &task,
+        IslandWorker &worker);
+    bool cutToDisk(std::vector<Vertex> &verticies, std::vector<CompactFace> &faces);
+    bool fixHolesExceptTheLongestRing(const std::vector<Vertex> &verticies, std::vector<CompactFace> &faces, size_t *remainingHoleNum=nullptr);
     void makeSeamAndCut(const std::vector<Vertex> &verticies,
-        const std::vector<Face> &faces,
-        std::map<size_t, size_t> &localToGlobalFacesMap,
-        std::vector<size_t> &firstGroup, std::vector<size_t> &secondGroup);
+        const std::vector<CompactFace> &faces,
+        const std::vector<Index> &localToGlobalFaces,
+        std::vector<Index> &firstGroup, std::vector<Index> &secondGroup);
+    bool calculateChartSize(const FaceTextureCoords *chartUvs, const Index *chartFaces, size_t chartFaceNum,
+        std::pair<float, float> &size, std::pair<float, float> &scaledSize, UvTransform &transform);
     void calculateSizeAndRemoveInvalidCharts();
     void packCharts();
     void finalizeUv();
-    void buildEdgeToFaceMap(const std::vector<size_t> &group, std::map<std::pair<size_t, size_t>, size_t> &edgeToFaceMap);
-    void buildEdgeToFaceMap(const std::vector<Face> &faces, std::map<std::pair<size_t, size_t>, size_t> &edgeToFaceMap);
+    void buildEdgeToFaceMap(const std::vector<CompactFace> &faces, std::map<std::pair<Index, Index>, Index> &edgeToFaceMap);
     double distanceBetweenVertices(const Vertex &first, const Vertex &second);
     float areaOf3dTriangle(const Eigen::Vector3d &a, const Eigen::Vector3d &b, const Eigen::Vector3d &c);
     float areaOf2dTriangle(const Eigen::Vector2d &a, const Eigen::Vector2d &b, const Eigen::Vector2d &c);
     void triangulateRing(const std::vector<Vertex> &verticies,
-        std::vector<Face> &faces, const std::vector<size_t> &ring);
-    void calculateFaceTextureBoundingBox(const std::vector<FaceTextureCoords> &faceTextureCoords,
-        float &left, float &top, float &right, float &bottom);
+        std::vector<CompactFace> &faces, const std::vector<Index> &ring);
 
-    Mesh m_mesh;
+    CompactMesh m_mesh;
     std::vector<FaceTextureCoords> m_faceUvs;
-    std::map<int, std::vector<size_t>> m_partitions;
-    std::vector<std::pair<std::vector<size_t>, std::vector<FaceTextureCoords>>> m_charts;
+    // Partition i owns m_partitionFaces[m_partitionOffsets[i], m_partitionOffsets[i + 1]),
+    // chart i owns the same range of m_chartFaces and m_chartUvs by m_chartOffsets
+    std::vector<int> m_partitionIds;
+    std::vector<size_t> m_partitionOffsets;
+    std::vector<Index> m_partitionFaces;
+    std::vector<size_t> m_chartOffsets;
+    std::vector<Index> m_chartFaces;
+    std::vector<FaceTextureCoords> m_chartUvs;
+    std::vector<UvTransform> m_chartTransforms;
     std::vector<std::pair<float, float>> m_chartSizes;
     std::vector<std::pair<float, float>> m_scaledChartSizes;
     std::vector<Rect> m_chartRects;
+    std::vector<PixelRect> m_chartPixelRects;
     std::vector<int> m_chartSourcePartitions;
+    std::unique_ptr<StreamingChartPacker> m_streamingChartPacker;
+    std::vector<size_t> m_chartStreamIndices;
     bool m_segmentByNormal = true;
     float m_segmentDotProductThreshold = 0.0;    //90 degrees
     float m_texelSizePerUnit = 1.0;
     float m_resultTextureSize = 0;
     bool m_segmentPreferMorePieces = true;
     bool m_enableRotation = true;
+    size_t m_threadNum = 0;
+    bool m_enableStreamingPack = false;
+    size_t m_skylinePackMinChartNum = 0;
+    float m_pageSize = 0;
+    int m_rasterPackResolution = 0;
+    int m_rasterPackPaddingPixels = 2;
+    int m_texelPackResolution = 0;
+    int m_texelPackPaddingPixels = 1;
+    ArapOptions m_arapOptions;
+    ParametrizationMethod m_parametrizationMethod = ParametrizationMethod::Arap;
+    bool m_cutClosedIslandsToDisk = false;
+    size_t m_maxChartFaceNum = 0;
+    size_t m_smallIslandFaceNum = 0;
+    size_t m_mergedIslandNum = 0;
+    bool m_reuseCongruentIslands = false;
+    bool m_shareCongruentAtlasSpace = false;
+    size_t m_reusedIslandNum = 0;
+    std::vector<size_t> m_chartShareSources;
+    size_t m_resultPageNum = 0;
     static const std::vector<float> m_rotateDegrees;
 };
 
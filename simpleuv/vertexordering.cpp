@@ -0,0 +1,164 @@
+#include <vector>
+#include <algorithm>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+#include <simpleuv/vertexordering.h>
+
+namespace simpleuv
+{
+
+struct VertexAdjacency
+{
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+    int degree(int v) const
+    {
+        return offsets[v + 1] - offsets[v];
+    }
+};
+
+static void buildVertexAdjacency(int vertexNum, const Eigen::MatrixXi &F, VertexAdjacency &adjacency)
+{
+    adjacency.offsets.assign(vertexNum + 1, 0);
+    for (int f = 0; f < F.rows(); ++f) {
+        for (int j = 0; j < 3; ++j)
+            adjacency.offsets[F(f, j) + 1] += 2;
+    }
+    for (int v = 0; v < vertexNum; ++v)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    std::vector<int> ends(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    adjacency.neighbors.resize(adjacency.offsets[vertexNum]);
+    for (int f = 0; f < F.rows(); ++f) {
+        for (int j = 0; j < 3; ++j) {
+            int v = F(f, j);
+            adjacency.neighbors[ends[v]++] = F(f, (j + 1) % 3);
+            adjacency.neighbors[ends[v]++] = F(f, (j + 2) % 3);
+        }
+    }
+    // Every interior edge was added by both of its faces, compact in place
+    int write = 0;
+    for (int v = 0; v < vertexNum; ++v) {
+        auto begin = adjacency.neighbors.begin() + adjacency.offsets[v];
+        auto end = adjacency.neighbors.begin() + ends[v];
+        std::sort(begin, end);
+        auto uniqueEnd = std::unique(begin, end);
+        adjacency.offsets[v] = write;
+        write = std::copy(begin, uniqueEnd, adjacency.neighbors.begin() + write) - adjacency.neighbors.begin();
+    }
+    adjacency.offsets[vertexNum] = write;
+    adjacency.neighbors.resize(write);
+}
+
+// Breadth first from root over the vertices not yet ordered, returns the vertices of the last level
+static int breadthFirstLevels(const VertexAdjacency &adjacency, int root, const std::vector<char> &ordered,
+    std::vector<int> &stamps, int stamp, std::vector<int> &queue, std::vector<int> &lastLevel)
+{
+    queue.clear();
+    queue.push_back(root);
+    stamps[root] = stamp;
+    int levelNum = 0;
+    size_t levelBegin = 0;
+    while (levelBegin < queue.size()) {
+        size_t levelEnd = queue.size();
+        lastLevel.assign(queue.begin() + levelBegin, queue.begin() + levelEnd);
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            int v = queue[i];
+            for (int k = adjacency.offsets[v]; k < adjacency.offsets[v + 1]; ++k) {
+                int neighbor = adjacency.neighbors[k];
+                if (ordered[neighbor] || stamp == stamps[neighbor])
+                    continue;
+                stamps[neighbor] = stamp;
+                queue.push_back(neighbor);
+            }
+        }
+        levelBegin = levelEnd;
+        ++levelNum;
+    }
+    return levelNum;
+}
+
+static void reverseCuthillMcKee(int vertexNum, const VertexAdjacency &adjacency, std::vector<int> &order)
+{
+    std::vector<char> ordered(vertexNum, 0);
+    std::vector<int> stamps(vertexNum, 0);
+    int stamp = 0;
+    std::vector<int> queue;
+    std::vector<int> lastLevel;
+    std::vector<int> children;
+    order.clear();
+    order.reserve(vertexNum);
+    for (int seed = 0; seed < vertexNum; ++seed) {
+        if (ordered[seed])
+            continue;
+        // George-Liu pseudo peripheral vertex: keep jumping to a lowest degree vertex of the farthest level
+        // while that increases the eccentricity
+        int root = seed;
+        int levelNum = breadthFirstLevels(adjacency, root, ordered, stamps, ++stamp, queue, lastLevel);
+        for (;;) {
+            int candidate = *std::min_element(lastLevel.begin(), lastLevel.end(), [&](int a, int b) {
+                return adjacency.degree(a) < adjacency.degree(b);
+            });
+            int candidateLevelNum = breadthFirstLevels(adjacency, candidate, ordered, stamps, ++stamp, queue, lastLevel);
+            if (candidateLevelNum <= levelNum)
+                break;
+            root = candidate;
+            levelNum = candidateLevelNum;
+        }
+        size_t head = order.size();
+        order.push_back(root);
+        ordered[root] = 1;
+        while (head < order.size()) {
+            int v = order[head++];
+            children.clear();
+            for (int k = adjacency.offsets[v]; k < adjacency.offsets[v + 1]; ++k) {
+                int neighbor = adjacency.neighbors[k];
+                if (ordered[neighbor])
+                    continue;
+                ordered[neighbor] = 1;
+                children.push_back(neighbor);
+            }
+            std::stable_sort(children.begin(), children.end(), [&](int a, int b) {
+                return adjacency.degree(a) < adjacency.degree(b);
+            });
+            order.insert(order.end(), children.begin(), children.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+}
+
+void calculateVertexOrdering(int vertexNum, const Eigen::MatrixXi &F, VertexOrdering ordering,
+    Eigen::VectorXi &positions)
+{
+    positions.resize(vertexNum);
+    if (VertexOrdering::Natural == ordering) {
+        for (int v = 0; v < vertexNum; ++v)
+            positions(v) = v;
+        return;
+    }
+    VertexAdjacency adjacency;
+    buildVertexAdjacency(vertexNum, F, adjacency);
+    if (VertexOrdering::ReverseCuthillMcKee == ordering) {
+        std::vector<int> order;
+        reverseCuthillMcKee(vertexNum, adjacency, order);
+        for (int i = 0; i < vertexNum; ++i)
+            positions(order[i]) = i;
+        return;
+    }
+    // The pattern of the cotangent matrix, AMD gives the inverse permutation
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(adjacency.neighbors.size() + vertexNum);
+    for (int v = 0; v < vertexNum; ++v) {
+        triplets.push_back(Eigen::Triplet<double>(v, v, 1.0));
+        for (int k = adjacency.offsets[v]; k < adjacency.offsets[v + 1]; ++k)
+            triplets.push_back(Eigen::Triplet<double>(adjacency.neighbors[k], v, 1.0));
+    }
+    Eigen::SparseMatrix<double> pattern(vertexNum, vertexNum);
+    pattern.setFromTriplets(triplets.begin(), triplets.end());
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inversePermutation;
+    Eigen::AMDOrdering<int> amd;
+    amd(pattern, inversePermutation);
+    for (int i = 0; i < vertexNum; ++i)
+        positions(inversePermutation.indices()(i)) = i;
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef SIMPLEUV_VERTEX_ORDERING_H
+#define SIMPLEUV_VERTEX_ORDERING_H
+#include <Eigen/Core>
+
+namespace simpleuv
+{
+
+enum class VertexOrdering
+{
+    // Keep the vertices in the order the island visited them
+    Natural,
+    // Reverse Cuthill-McKee, bandwidth reducing, also lays neighbors out close in memory
+    ReverseCuthillMcKee,
+    // Approximate minimum degree, fill reducing
+    MinimumDegree
+};
+
+// positions[v] is where vertex v goes, the vertices are the rows the faces index
+void calculateVertexOrdering(int vertexNum, const Eigen::MatrixXi &F, VertexOrdering ordering,
+    Eigen::VectorXi &positions);
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include <thread>
+#include <chrono>
+#include <simpleuv/workstealingpool.h>
+
+namespace simpleuv
+{
+
+WorkStealingPool::WorkStealingPool(size_t workerNum) :
+    m_pendingTaskNum(0)
+{
+    if (0 == workerNum)
+        workerNum = 1;
+    for (size_t i = 0; i < workerNum; ++i)
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+}
+
+size_t WorkStealingPool::workerNum() const
+{
+    return m_workers.size();
+}
+
+void WorkStealingPool::run(std::vector<Task> &tasks)
+{
+    m_pendingTaskNum += tasks.size();
+    for (size_t i = 0; i < tasks.size(); ++i)
+        m_workers[i % m_workers.size()]->tasks.push_back(tasks[i]);
+    
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < m_workers.size(); ++i)
+        threads.push_back(std::thread(&WorkStealingPool::work, this, i));
+    work(0);
+    for (auto &thread: threads)
+        thread.join();
+}
+
+void WorkStealingPool::spawn(size_t workerIndex, const Task &task)
+{
+    ++m_pendingTaskNum;
+    {
+        std::lock_guard<std::mutex> lock(m_workers[workerIndex]->mutex);
+        m_workers[workerIndex]->tasks.push_front(task);
+    }
+    m_idleCondition.notify_all();
+}
+
+bool WorkStealingPool::takeTask(size_t workerIndex, Task &task)
+{
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        auto &worker = *m_workers[(workerIndex + i) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            continue;
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::work(size_t workerIndex)
+{
+    while (true) {
+        Task task;
+        if (takeTask(workerIndex, task)) {
+            task(workerIndex);
+            if (0 == --m_pendingTaskNum)
+                m_idleCondition.notify_all();
+            continue;
+        }
+        if (0 == m_pendingTaskNum)
+            break;
+        // Nothing to steal while the running tasks may still spawn more, the timeout covers a missed notify
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCondition.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+}
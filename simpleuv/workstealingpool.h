@@ -0,0 +1,47 @@
+#ifndef SIMPLEUV_WORK_STEALING_POOL_H
+#define SIMPLEUV_WORK_STEALING_POOL_H
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace simpleuv
+{
+
+// Every worker owns a task queue, takes from the front of it, and when it's empty
+// steals from the front of the others, so the largest remaining tasks always go first.
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(size_t workerIndex)> Task;
+
+    explicit WorkStealingPool(size_t workerNum);
+    size_t workerNum() const;
+    // Tasks are dealt to the workers round robin in the given order, so pass them largest first.
+    // Returns after all of them, and all the tasks they spawned, finished. Worker 0 is the calling thread.
+    void run(std::vector<Task> &tasks);
+    // Only from inside a running task, the new task goes to the front of the calling worker's queue
+    void spawn(size_t workerIndex, const Task &task);
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool takeTask(size_t workerIndex, Task &task);
+    void work(size_t workerIndex);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<size_t> m_pendingTaskNum;
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCondition;
+};
+
+}
+
+#endif